@@ -0,0 +1,401 @@
+// Host-side benchmark for the kernel heap. kernel/memory.c is compiled
+// unchanged into a Linux program and driven either by synthetic
+// workloads or by a trace captured from the kernel with "memtrace on"
+// (the "MT" lines it writes to the serial port).
+//
+//   alloc_bench                  run every synthetic workload
+//   alloc_bench <workload>...    run some of them (churn mixed realloc frag)
+//   alloc_bench replay <log>     replay a serial log
+//
+// Build and run with "make bench-alloc" (BENCH_ARGS="..." for arguments).
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "../kernel/memory.h"
+#include "../kernel/kernel.h"
+
+// The heap grows inside one reserve, the way the kernel's does inside its
+// virtual window, so growth extends the last region in place. Like the
+// kernel's heap pages it is zero-filled until used.
+#define RESERVE_SIZE (256u << 20)
+#define SAMPLES      8
+
+static uint8_t* reserve;
+static size_t reserve_used;
+
+static void* grow_heap(size_t min_size, size_t* size) {
+    size_t step = (min_size + KERNEL_HEAP_GROW - 1) & ~(size_t)(KERNEL_HEAP_GROW - 1);
+    if (step > RESERVE_SIZE - reserve_used) return NULL;
+
+    void* start = reserve + reserve_used;
+    reserve_used += step;
+    *size = step;
+    return start;
+}
+
+static void heap_reset(void) {
+    memset(reserve, 0, reserve_used);
+    reserve_used = KERNEL_HEAP_SIZE;
+    memory_init(reserve, KERNEL_HEAP_SIZE);
+    memory_set_grow_handler(grow_heap);
+}
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// --- Measurement ---
+
+typedef struct {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t ops;
+    uint64_t sample_every;
+    double peak_frag;                   // 1 - largest_free / free
+    size_t largest[SAMPLES];
+    int sample_count;
+} bench_t;
+
+static void bench_begin(bench_t* b, const char* name, uint64_t expected_ops) {
+    memset(b, 0, sizeof(*b));
+    b->name = name;
+    b->sample_every = expected_ops / SAMPLES ? expected_ops / SAMPLES : 1;
+    b->start_ns = now_ns();
+}
+
+static void bench_sample(bench_t* b) {
+    size_t free_size = memory_get_free();
+    size_t largest = memory_get_largest_free();
+
+    if (free_size > 0) {
+        double frag = 1.0 - (double)largest / (double)free_size;
+        if (frag > b->peak_frag) b->peak_frag = frag;
+    }
+    if (b->sample_count < SAMPLES && b->ops >= (uint64_t)(b->sample_count + 1) * b->sample_every) {
+        b->largest[b->sample_count++] = largest;
+    }
+}
+
+// Count one operation; fragmentation is sampled every 256
+static inline void bench_op(bench_t* b) {
+    if ((++b->ops & 255) == 0) {
+        bench_sample(b);
+    }
+}
+
+static void bench_end(bench_t* b) {
+    uint64_t elapsed = now_ns() - b->start_ns;
+    memory_stats_t stats;
+    memory_get_stats(&stats);
+
+    printf("%-10s %9llu ops  %7.1f ns/op  peak frag %5.1f%%  heap %6zu KB  failed %zu  %s\n",
+           b->name, (unsigned long long)b->ops,
+           b->ops ? (double)elapsed / (double)b->ops : 0.0,
+           b->peak_frag * 100.0, stats.total_size / 1024, stats.failed_allocs,
+           memory_validate() ? "valid" : "CORRUPT");
+    printf("           largest free (KB):");
+    for (int i = 0; i < b->sample_count; i++) {
+        printf(" %zu", b->largest[i] / 1024);
+    }
+    printf("\n");
+}
+
+// --- Synthetic workloads ---
+
+// Many small objects allocated and freed at random
+static void run_churn(void) {
+    enum { SLOTS = 4096, OPS = 1000000 };
+    static void* slot[SLOTS];
+    bench_t b;
+
+    heap_reset();
+    memset(slot, 0, sizeof(slot));
+    bench_begin(&b, "churn", OPS);
+    for (int i = 0; i < OPS; i++) {
+        uint32_t s = rng() % SLOTS;
+        if (slot[s]) {
+            kfree(slot[s]);
+            slot[s] = NULL;
+        } else {
+            slot[s] = kmalloc(16 + rng() % 113);
+        }
+        bench_op(&b);
+    }
+    bench_end(&b);
+}
+
+// Sizes drawn from a skewed mix: mostly small, some pages, a few large
+static size_t mixed_size(void) {
+    uint32_t r = rng() % 100;
+    if (r < 70) return 16 + rng() % 241;
+    if (r < 95) return 256 + rng() % 3841;
+    return 4096 + rng() % 61441;
+}
+
+static void run_mixed(void) {
+    enum { SLOTS = 2048, OPS = 500000 };
+    static void* slot[SLOTS];
+    bench_t b;
+
+    heap_reset();
+    memset(slot, 0, sizeof(slot));
+    bench_begin(&b, "mixed", OPS);
+    for (int i = 0; i < OPS; i++) {
+        uint32_t s = rng() % SLOTS;
+        if (slot[s]) {
+            kfree(slot[s]);
+            slot[s] = NULL;
+        } else {
+            slot[s] = (rng() & 7) ? kmalloc(mixed_size()) : kcalloc(1, mixed_size());
+        }
+        bench_op(&b);
+    }
+    bench_end(&b);
+}
+
+// Buffers grown a little at a time, like text being typed or a page
+// being read in, then dropped
+static void run_realloc(void) {
+    enum { BUFFERS = 256, OPS = 500000, LIMIT = 65536 };
+    static void* buf[BUFFERS];
+    static size_t len[BUFFERS];
+    bench_t b;
+
+    heap_reset();
+    memset(buf, 0, sizeof(buf));
+    memset(len, 0, sizeof(len));
+    bench_begin(&b, "realloc", OPS);
+    for (int i = 0; i < OPS; i++) {
+        uint32_t s = rng() % BUFFERS;
+        if (len[s] >= LIMIT) {
+            kfree(buf[s]);
+            buf[s] = NULL;
+            len[s] = 0;
+        } else {
+            size_t new_len = len[s] + 1 + rng() % 512;
+            void* p = krealloc(buf[s], new_len);
+            if (p) {
+                buf[s] = p;
+                len[s] = new_len;
+            }
+        }
+        bench_op(&b);
+    }
+    for (int s = 0; s < BUFFERS; s++) kfree(buf[s]);
+    bench_end(&b);
+}
+
+// Long-lived small objects pinned between short-lived large ones, then
+// the large ones freed so only scattered holes are left
+static void run_frag(void) {
+    enum { ROUNDS = 40, PAIRS = 1024 };
+    static void* small[PAIRS];
+    static void* large[PAIRS];
+    bench_t b;
+
+    heap_reset();
+    bench_begin(&b, "frag", (uint64_t)ROUNDS * PAIRS * 4);
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < PAIRS; i++) {
+            large[i] = kmalloc(512 + rng() % 2048);
+            bench_op(&b);
+            small[i] = kmalloc(16 + rng() % 48);
+            bench_op(&b);
+        }
+        for (int i = 0; i < PAIRS; i++) {
+            kfree(large[i]);
+            bench_op(&b);
+        }
+        // Keep one small object in eight for good
+        for (int i = 0; i < PAIRS; i++) {
+            if (i % 8) kfree(small[i]);
+            bench_op(&b);
+        }
+    }
+    bench_sample(&b);
+    bench_end(&b);
+}
+
+// --- Trace replay ---
+
+// Trace addresses to host blocks, open addressing
+typedef struct {
+    uint32_t key;                       // Kernel address, 0 if empty
+    void* ptr;
+} trace_slot_t;
+
+static trace_slot_t* trace_map;
+static size_t trace_map_size;
+
+static trace_slot_t* trace_find(uint32_t key, int insert) {
+    size_t i = (key >> 3) * 2654435761u % trace_map_size;
+    trace_slot_t* tomb = NULL;
+
+    for (size_t n = 0; n < trace_map_size; n++, i = (i + 1) % trace_map_size) {
+        trace_slot_t* s = &trace_map[i];
+        if (s->key == key && s->ptr) return s;
+        if (s->key == 0) {
+            if (!insert) return NULL;
+            return tomb ? tomb : s;
+        }
+        if (s->ptr == NULL && tomb == NULL) tomb = s;  // Removed entry
+    }
+    return insert ? tomb : NULL;
+}
+
+static void trace_put(uint32_t key, void* ptr) {
+    trace_slot_t* s = trace_find(key, 1);
+    if (s) {
+        s->key = key;
+        s->ptr = ptr;
+    }
+}
+
+static void* trace_take(uint32_t key) {
+    trace_slot_t* s = trace_find(key, 0);
+    if (s == NULL) return NULL;
+    void* ptr = s->ptr;
+    s->ptr = NULL;                      // Keep the key as a tombstone
+    return ptr;
+}
+
+static int run_replay(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    // Count events first so sampling is spread over the whole trace
+    char line[256];
+    uint64_t events = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strstr(line, "MT ")) events++;
+    }
+    rewind(f);
+
+    trace_map_size = 1u << 20;
+    trace_map = calloc(trace_map_size, sizeof(trace_slot_t));
+    if (trace_map == NULL) {
+        fclose(f);
+        return 1;
+    }
+
+    bench_t b;
+    uint64_t unmatched = 0;
+    heap_reset();
+    bench_begin(&b, "replay", events);
+
+    while (fgets(line, sizeof(line), f)) {
+        const char* p = strstr(line, "MT ");
+        char op;
+        unsigned int ptr, old_ptr;
+        unsigned long size, align;
+
+        if (p == NULL || sscanf(p, "MT %c %x %x %lu %lu", &op, &ptr, &old_ptr, &size, &align) != 5) {
+            continue;
+        }
+
+        switch (op) {
+            case 'm': {
+                void* h = align > 8 ? kmalloc_aligned(size, align) : kmalloc(size);
+                if (h && ptr) trace_put(ptr, h);
+                break;
+            }
+            case 'r': {
+                void* old_h = old_ptr ? trace_take(old_ptr) : NULL;
+                if (old_ptr && old_h == NULL) unmatched++;
+                void* h = krealloc(old_h, size);
+                if (h && ptr) {
+                    trace_put(ptr, h);
+                } else if (old_h && size) {
+                    trace_put(old_ptr, old_h);  // Failed; the old block stays
+                }
+                break;
+            }
+            case 'f': {
+                if (ptr == 0) break;
+                void* h = trace_take(ptr);
+                if (h == NULL) unmatched++;
+                kfree(h);
+                break;
+            }
+            case 'v': {
+                // The kernel's compactor moved a block; follow it
+                void* h = trace_take(old_ptr);
+                if (h) trace_put(ptr, h);
+                break;
+            }
+            default:
+                continue;
+        }
+        bench_op(&b);
+    }
+
+    bench_sample(&b);
+    bench_end(&b);
+    if (unmatched) {
+        printf("           %llu events referred to blocks not in the trace\n",
+               (unsigned long long)unmatched);
+    }
+
+    free(trace_map);
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    static const struct {
+        const char* name;
+        void (*run)(void);
+    } workloads[] = {
+        { "churn", run_churn },
+        { "mixed", run_mixed },
+        { "realloc", run_realloc },
+        { "frag", run_frag },
+    };
+    const int count = sizeof(workloads) / sizeof(workloads[0]);
+
+    reserve = mmap(NULL, RESERVE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserve == MAP_FAILED) {
+        fprintf(stderr, "cannot reserve %u MB\n", RESERVE_SIZE >> 20);
+        return 1;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "replay") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "usage: %s replay <serial log>\n", argv[0]);
+            return 2;
+        }
+        return run_replay(argv[2]);
+    }
+
+    for (int i = 0; i < count; i++) {
+        int wanted = argc < 2;
+        for (int a = 1; a < argc; a++) {
+            if (strcmp(argv[a], workloads[i].name) == 0) wanted = 1;
+        }
+        if (wanted) {
+            rng_state = 0x9E3779B9u;
+            workloads[i].run();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,554 @@
+// Host-side checker and benchmark for kernel/string.c. The file is built
+// unchanged into a Linux program (its functions renamed to kstr_* by
+// string_names.h) and compared against the C library:
+//
+//   string_bench                 check every function, then time them
+//   string_bench check [name]... fuzz-compare results with glibc
+//   string_bench speed [name]... throughput from 1 B to 1 MB
+//
+// The checks vary alignment and length and put buffers against a
+// PROT_NONE page, so a read past the end of a string faults here instead
+// of going unnoticed. Build and run with "make bench-string" (BENCH_ARGS
+// for arguments).
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "string_names.h"
+#include "../kernel/string.h"
+
+// The C library's versions, by symbol name since the plain names now
+// refer to the kernel's
+size_t libc_strlen(const char* s) __asm__("strlen");
+char* libc_strchr(const char* s, int c) __asm__("strchr");
+int libc_strcmp(const char* a, const char* b) __asm__("strcmp");
+int libc_strncmp(const char* a, const char* b, size_t n) __asm__("strncmp");
+char* libc_strstr(const char* h, const char* n) __asm__("strstr");
+char* libc_strncpy(char* d, const char* s, size_t n) __asm__("strncpy");
+void* libc_memchr(const void* p, int c, size_t n) __asm__("memchr");
+void* libc_memrchr(const void* p, int c, size_t n) __asm__("memrchr");
+void* libc_memmem(const void* h, size_t hl, const void* n, size_t nl) __asm__("memmem");
+void* libc_memcpy(void* d, const void* s, size_t n) __asm__("memcpy");
+void* libc_memmove(void* d, const void* s, size_t n) __asm__("memmove");
+void* libc_memset(void* p, int c, size_t n) __asm__("memset");
+int libc_memcmp(const void* a, const void* b, size_t n) __asm__("memcmp");
+int libc_vsnprintf(char* buf, size_t size, const char* format, va_list args) __asm__("vsnprintf");
+
+#define PAGE        4096
+#define AREA_PAGES  16              // Readable pages before each guard page
+#define MAX_ALIGN   16
+#define SPEED_MAX   (1u << 20)
+#define SPEED_NS    20000000u       // Time each measurement for ~20 ms
+
+static uint32_t rng_state = 0x9E3779B9u;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int sign(int v) {
+    return (v > 0) - (v < 0);
+}
+
+// --- Guarded buffers ---
+
+// Two areas, each followed by an unreadable page
+static unsigned char* area[2];
+
+static void areas_init(void) {
+    for (int i = 0; i < 2; i++) {
+        size_t size = (AREA_PAGES + 1) * PAGE;
+        unsigned char* p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED || mprotect(p + AREA_PAGES * PAGE, PAGE, PROT_NONE) != 0) {
+            perror("mmap");
+            exit(1);
+        }
+        area[i] = p;
+    }
+}
+
+// len bytes in area a, either starting align bytes into a cache line or
+// ending right at the guard page
+static unsigned char* place(int a, size_t len, size_t align, bool at_end) {
+    if (at_end) return area[a] + AREA_PAGES * PAGE - len;
+    return area[a] + PAGE + align;
+}
+
+// Random bytes, none of them zero or equal to avoid
+static void fill_random(unsigned char* p, size_t len, int avoid) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c;
+        do {
+            c = (unsigned char)rng();
+        } while (c == 0 || c == avoid);
+        p[i] = c;
+    }
+}
+
+// Lengths every check runs: all the short ones, then ones around word,
+// vector and page boundaries
+static const size_t long_lengths[] = {
+    511, 512, 513, 1000, 4095, 4096, 4097, 8191, 12345, 3 * PAGE + 7,
+};
+
+#define SHORT_MAX 300
+
+static size_t length_at(size_t i) {
+    return i <= SHORT_MAX ? i : long_lengths[i - SHORT_MAX - 1];
+}
+
+#define LENGTH_COUNT (SHORT_MAX + 1 + sizeof(long_lengths) / sizeof(long_lengths[0]))
+
+// --- Checks ---
+
+static int failures;
+static int failures_here;
+
+static void fail(const char* fmt, ...) {
+    va_list args;
+
+    failures++;
+    if (++failures_here > 5) return;
+    printf("  FAIL ");
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+}
+
+static void check_memcpy(void) {
+    for (size_t i = 0; i < LENGTH_COUNT; i++) {
+        size_t len = length_at(i);
+        for (size_t sa = 0; sa < MAX_ALIGN; sa++) {
+            size_t da = (sa * 7 + len) % MAX_ALIGN;
+            unsigned char* src = place(0, len, sa, sa & 1);
+            unsigned char* dst = place(1, len + 16, da, false) + 8;
+            fill_random(src, len, -1);
+            libc_memset(dst - 8, 0xA5, len + 16);
+
+            void* r = memcpy(dst, src, len);
+            if (r != dst || libc_memcmp(dst, src, len) != 0) {
+                fail("memcpy len %zu src+%zu dst+%zu: wrong bytes", len, sa, da);
+            }
+            for (int g = 1; g <= 8; g++) {
+                if (dst[-g] != 0xA5 || dst[len + g - 1] != 0xA5) {
+                    fail("memcpy len %zu src+%zu dst+%zu: wrote outside", len, sa, da);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void check_memmove(void) {
+    static unsigned char ref[4 * PAGE], out[4 * PAGE];
+
+    for (size_t i = 0; i < LENGTH_COUNT; i++) {
+        size_t len = length_at(i);
+        if (len + 64 > sizeof(ref)) continue;
+        for (size_t s = 0; s < 32; s += 3) {
+            for (size_t d = 0; d < 32; d += 5) {
+                fill_random(out, len + 64, -1);
+                libc_memcpy(ref, out, len + 64);
+                libc_memmove(ref + d, ref + s, len);
+                if (memmove(out + d, out + s, len) != out + d ||
+                    libc_memcmp(out, ref, len + 64) != 0) {
+                    fail("memmove len %zu src+%zu dst+%zu", len, s, d);
+                }
+            }
+        }
+    }
+}
+
+static void check_memset(void) {
+    for (size_t i = 0; i < LENGTH_COUNT; i++) {
+        size_t len = length_at(i);
+        for (size_t a = 0; a < MAX_ALIGN; a++) {
+            unsigned char* p = place(1, len + 16, a, false) + 8;
+            int value = (int)(rng() & 0x1FF);           // Only the low byte counts
+            libc_memset(p - 8, 0xA5, len + 16);
+
+            if (memset(p, value, len) != p) fail("memset len %zu: return value", len);
+            for (size_t k = 0; k < len; k++) {
+                if (p[k] != (unsigned char)value) {
+                    fail("memset len %zu +%zu: byte %zu", len, a, k);
+                    break;
+                }
+            }
+            if (p[-1] != 0xA5 || p[len] != 0xA5) fail("memset len %zu +%zu: wrote outside", len, a);
+        }
+    }
+}
+
+static void check_memcmp(void) {
+    for (size_t i = 1; i < LENGTH_COUNT; i++) {
+        size_t len = length_at(i);
+        for (size_t a = 0; a < MAX_ALIGN; a++) {
+            unsigned char* x = place(0, len, a, a & 1);
+            unsigned char* y = place(1, len, (a * 5) % MAX_ALIGN, !(a & 1));
+            fill_random(x, len, -1);
+            libc_memcpy(y, x, len);
+            if (rng() & 3) y[rng() % len] = (unsigned char)rng();
+
+            int want = sign(libc_memcmp(x, y, len));
+            if (sign(memcmp(x, y, len)) != want) fail("memcmp len %zu +%zu: want %d", len, a, want);
+        }
+    }
+}
+
+// Buffer of len bytes without c, then c dropped at up to two places
+static size_t plant(unsigned char* p, size_t len, int c) {
+    fill_random(p, len, c);
+    size_t planted = rng() % 3;
+    for (size_t k = 0; k < planted && len; k++) {
+        p[rng() % len] = (unsigned char)c;
+    }
+    return planted;
+}
+
+static void check_memchr(void) {
+    for (size_t i = 0; i < LENGTH_COUNT; i++) {
+        size_t len = length_at(i);
+        for (size_t a = 0; a < MAX_ALIGN; a++) {
+            unsigned char* p = place(0, len, a, a & 1);
+            int c = (a & 2) ? 0 : (int)(rng() & 0xFF);
+            plant(p, len, c);
+            if (len) p[rng() % len] = 0;                // memchr must not stop at NUL
+
+            if (memchr(p, c | 0x100, len) != libc_memchr(p, c, len)) {
+                fail("memchr len %zu +%zu c %02x", len, a, c);
+            }
+            if (memrchr(p, c, len) != libc_memrchr(p, c, len)) {
+                fail("memrchr len %zu +%zu c %02x", len, a, c);
+            }
+        }
+    }
+}
+
+static void check_strlen(void) {
+    for (size_t i = 0; i < LENGTH_COUNT; i++) {
+        size_t len = length_at(i);
+        for (size_t a = 0; a < MAX_ALIGN; a++) {
+            char* s = (char*)place(0, len + 1, a, a & 1);
+            int c = 1 + (int)(rng() % 255);
+            fill_random((unsigned char*)s, len, -1);
+            s[len] = '\0';
+            if (a & 4 && len) s[rng() % len] = (char)c;
+
+            if (strlen(s) != len) fail("strlen len %zu +%zu: got %zu", len, a, strlen(s));
+            if (strchr(s, c) != libc_strchr(s, c)) fail("strchr len %zu +%zu c %02x", len, a, c);
+            if (strchr(s, 0) != s + len) fail("strchr len %zu +%zu: NUL", len, a);
+        }
+    }
+}
+
+static void check_strcmp(void) {
+    for (size_t i = 0; i < LENGTH_COUNT; i++) {
+        size_t len = length_at(i);
+        for (size_t a = 0; a < MAX_ALIGN; a++) {
+            char* x = (char*)place(0, len + 1, a, a & 1);
+            char* y = (char*)place(1, len + 1, (a * 3) % MAX_ALIGN, a & 2);
+            fill_random((unsigned char*)x, len, -1);
+            x[len] = '\0';
+            libc_memcpy(y, x, len + 1);
+            if (len && (rng() & 3)) {
+                size_t at = rng() % len;
+                y[at] = (rng() & 1) ? (char)(rng() | 1) : '\0';
+            }
+
+            int want = sign(libc_strcmp(x, y));
+            if (sign(strcmp(x, y)) != want) fail("strcmp len %zu +%zu: want %d", len, a, want);
+
+            size_t n = rng() % (len + 8);
+            want = sign(libc_strncmp(x, y, n));
+            if (sign(strncmp(x, y, n)) != want) fail("strncmp len %zu n %zu: want %d", len, n, want);
+        }
+    }
+}
+
+static void check_strstr(void) {
+    for (size_t i = 0; i < LENGTH_COUNT; i++) {
+        size_t len = length_at(i);
+        for (int round = 0; round < 24; round++) {
+            // A small alphabet so needles have near misses
+            char* h = (char*)place(0, len + 1, round % MAX_ALIGN, round & 1);
+            for (size_t k = 0; k < len; k++) h[k] = 'a' + rng() % (round < 12 ? 2 : 4);
+            h[len] = '\0';
+
+            char needle[40];
+            size_t nlen = rng() % 24;
+            if (nlen <= len && (round & 2)) {
+                libc_memcpy(needle, h + rng() % (len - nlen + 1), nlen);
+            } else {
+                for (size_t k = 0; k < nlen; k++) needle[k] = 'a' + rng() % 3;
+            }
+            needle[nlen] = '\0';
+            char* n = (char*)place(1, nlen + 1, 0, true);
+            libc_memcpy(n, needle, nlen + 1);
+
+            if (strstr(h, n) != libc_strstr(h, n)) {
+                fail("strstr len %zu needle \"%s\"", len, needle);
+            }
+            if (memmem(h, len, n, nlen) != libc_memmem(h, len, n, nlen)) {
+                fail("memmem len %zu needle \"%s\"", len, needle);
+            }
+        }
+    }
+}
+
+static void check_strcpy(void) {
+    static char want[512], got[512];
+
+    for (size_t len = 0; len < 200; len++) {
+        char* s = (char*)place(0, len + 1, 0, true);
+        fill_random((unsigned char*)s, len, -1);
+        s[len] = '\0';
+
+        libc_memset(got, 'x', sizeof(got));
+        if (strcpy(got, s) != got || libc_strcmp(got, s) != 0 || got[len + 1] != 'x') {
+            fail("strcpy len %zu", len);
+        }
+        strcat(got, s);
+        if (strlen(got) != 2 * len || libc_memcmp(got + len, s, len) != 0) {
+            fail("strcat len %zu", len);
+        }
+
+        size_t n = rng() % 256;
+        libc_memset(want, 'x', sizeof(want));
+        libc_memset(got, 'x', sizeof(got));
+        libc_strncpy(want, s, n);
+        if (strncpy(got, s, n) != got || libc_memcmp(want, got, sizeof(got)) != 0) {
+            fail("strncpy len %zu n %zu", len, n);
+        }
+    }
+}
+
+// Format with both implementations into buffers of a few sizes
+static void check_format(const char* format, ...) {
+    static const size_t sizes[] = { 0, 1, 5, 200 };
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char want[200], got[200];
+        va_list a, b;
+
+        libc_memset(want, '#', sizeof(want));
+        libc_memset(got, '#', sizeof(got));
+        va_start(a, format);
+        int want_len = libc_vsnprintf(want, sizes[i], format, a);
+        va_end(a);
+        va_start(b, format);
+        int got_len = vsnprintf(got, sizes[i], format, b);
+        va_end(b);
+
+        if (want_len != got_len || libc_memcmp(want, got, sizeof(got)) != 0) {
+            fail("vsnprintf \"%s\" size %zu: want \"%.*s\" (%d), got \"%.*s\" (%d)",
+                 format, sizes[i], (int)sizes[i], want, want_len, (int)sizes[i], got, got_len);
+        }
+    }
+}
+
+static void check_vsnprintf(void) {
+    static const char* const int_formats[] = {
+        "%d", "%i", "%5d", "%-5d|", "%05d", "%+d", "% d", "%.3d", "%8.3d", "%-+6d|",
+        "%u", "%x", "%X", "%#x", "%#X", "%08x", "%#010x", "%o", "%#o", "%.0d",
+    };
+    static const char* const words[] = { "", "a", "hello", "MiniOS browser" };
+
+    for (int round = 0; round < 2000; round++) {
+        int v = (int)rng() >> (rng() % 32);
+        if (round < 8) v = (int[]){ 0, 1, -1, 9, -10, 2147483647, -2147483647 - 1, 255 }[round];
+        const char* f = int_formats[round % (sizeof(int_formats) / sizeof(int_formats[0]))];
+        check_format(f, v);
+
+        long long big = ((long long)rng() << 32 | rng()) >> (rng() % 64);
+        check_format("%lld %llu %llx", big, (unsigned long long)big, (unsigned long long)big);
+        check_format("%zu %zx", (size_t)big, (size_t)big);
+        check_format("%hhd %hhu %hd %hu", v, v, v, v);
+
+        const char* w = words[round % 4];
+        int width = (int)(rng() % 20);
+        int precision = (int)(rng() % 8);
+        check_format("[%s] [%10s] [%-10s] [%.2s] [%*s] [%-*.*s]", w, w, w, w, width, w,
+                     width, precision, w);
+        check_format("%c%c %3c|%-3c| %%", 'M', 'i', 'x', 'y');
+    }
+}
+
+// --- Throughput ---
+
+static unsigned char* speed_src;
+static unsigned char* speed_dst;
+static void* volatile sink;
+static volatile int sink_int;
+
+// Needle strstr looks for; prepare_strstr puts it only at the very end
+static const char speed_needle[] = "</script>";
+
+static void prepare_bytes(size_t n) {
+    fill_random(speed_src, n, 0);
+}
+
+static void prepare_string(size_t n) {
+    fill_random(speed_src, n, 0);
+    speed_src[n] = '\0';
+    libc_memcpy(speed_dst, speed_src, n + 1);
+}
+
+static void prepare_strstr(size_t n) {
+    for (size_t k = 0; k < n; k++) speed_src[k] = "<script>/ab"[rng() % 11];
+    size_t nlen = sizeof(speed_needle) - 1;
+    if (n >= nlen) libc_memcpy(speed_src + n - nlen, speed_needle, nlen);
+    speed_src[n] = '\0';
+}
+
+static void k_memcpy(size_t n)  { sink = memcpy(speed_dst, speed_src, n); }
+static void c_memcpy(size_t n)  { sink = libc_memcpy(speed_dst, speed_src, n); }
+static void k_memmove(size_t n) { sink = memmove(speed_src + 1, speed_src, n); }
+static void c_memmove(size_t n) { sink = libc_memmove(speed_src + 1, speed_src, n); }
+static void k_memset(size_t n)  { sink = memset(speed_dst, 0x20, n); }
+static void c_memset(size_t n)  { sink = libc_memset(speed_dst, 0x20, n); }
+static void k_memchr(size_t n)  { sink = memchr(speed_src, 0, n); }
+static void c_memchr(size_t n)  { sink = libc_memchr(speed_src, 0, n); }
+static void k_strlen(size_t n)  { (void)n; sink_int = (int)strlen((char*)speed_src); }
+static void c_strlen(size_t n)  { (void)n; sink_int = (int)libc_strlen((char*)speed_src); }
+static void k_strcmp(size_t n)  { (void)n; sink_int = strcmp((char*)speed_src, (char*)speed_dst); }
+static void c_strcmp(size_t n)  { (void)n; sink_int = libc_strcmp((char*)speed_src, (char*)speed_dst); }
+static void k_strstr(size_t n)  { (void)n; sink = strstr((char*)speed_src, speed_needle); }
+static void c_strstr(size_t n)  { (void)n; sink = libc_strstr((char*)speed_src, speed_needle); }
+
+typedef struct {
+    const char* name;
+    void (*prepare)(size_t n);
+    void (*kernel)(size_t n);
+    void (*libc)(size_t n);
+} speed_case_t;
+
+static const speed_case_t speed_cases[] = {
+    { "memcpy", prepare_bytes, k_memcpy, c_memcpy },
+    { "memmove", prepare_bytes, k_memmove, c_memmove },
+    { "memset", prepare_bytes, k_memset, c_memset },
+    { "memchr", prepare_bytes, k_memchr, c_memchr },
+    { "strlen", prepare_string, k_strlen, c_strlen },
+    { "strcmp", prepare_string, k_strcmp, c_strcmp },
+    { "strstr", prepare_strstr, k_strstr, c_strstr },
+};
+
+// Best of three runs, in MB/s; each run repeats fn for about SPEED_NS
+static double throughput(void (*fn)(size_t), size_t n) {
+    double best = 0;
+
+    for (int run = 0; run < 3; run++) {
+        uint64_t calls = 0;
+        uint64_t batch = 1;
+        uint64_t start = now_ns();
+        uint64_t elapsed;
+        do {
+            for (uint64_t i = 0; i < batch; i++) fn(n);
+            calls += batch;
+            batch *= 2;
+            elapsed = now_ns() - start;
+        } while (elapsed < SPEED_NS / 3);
+
+        double mb_s = (double)calls * n / (elapsed / 1e9) / 1e6;
+        if (mb_s > best) best = mb_s;
+    }
+    return best;
+}
+
+static void run_speed(const speed_case_t* c) {
+    printf("%s\n%10s %12s %12s %7s\n", c->name, "bytes", "kernel MB/s", "libc MB/s", "ratio");
+    for (size_t n = 1; n <= SPEED_MAX; n *= 4) {
+        c->prepare(n);
+        double k = throughput(c->kernel, n);
+        double l = throughput(c->libc, n);
+        printf("%10zu %12.0f %12.0f %7.2f\n", n, k, l, k / l);
+    }
+    printf("\n");
+}
+
+// --- Driver ---
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} check_case_t;
+
+static const check_case_t check_cases[] = {
+    { "memcpy", check_memcpy },
+    { "memmove", check_memmove },
+    { "memset", check_memset },
+    { "memcmp", check_memcmp },
+    { "memchr", check_memchr },
+    { "strlen", check_strlen },
+    { "strcmp", check_strcmp },
+    { "strstr", check_strstr },
+    { "strcpy", check_strcpy },
+    { "vsnprintf", check_vsnprintf },
+};
+
+static bool wanted(const char* name, int argc, char** argv) {
+    if (argc == 0) return true;
+    for (int a = 0; a < argc; a++) {
+        if (libc_strcmp(argv[a], name) == 0) return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    bool do_check = true;
+    bool do_speed = true;
+
+    if (argc >= 2 && libc_strcmp(argv[1], "check") == 0) {
+        do_speed = false;
+        argc--, argv++;
+    } else if (argc >= 2 && libc_strcmp(argv[1], "speed") == 0) {
+        do_check = false;
+        argc--, argv++;
+    }
+    argc--, argv++;
+
+    string_init();
+    printf("kernel copy strategy: %s\n\n", string_variant());
+    areas_init();
+
+    if (do_check) {
+        for (size_t i = 0; i < sizeof(check_cases) / sizeof(check_cases[0]); i++) {
+            if (!wanted(check_cases[i].name, argc, argv)) continue;
+            failures_here = 0;
+            check_cases[i].run();
+            printf("check %-10s %s\n", check_cases[i].name, failures_here ? "FAILED" : "ok");
+        }
+        printf("\n");
+    }
+
+    if (do_speed) {
+        speed_src = aligned_alloc(64, SPEED_MAX + 64);
+        speed_dst = aligned_alloc(64, SPEED_MAX + 64);
+        if (speed_src == NULL || speed_dst == NULL) return 1;
+        for (size_t i = 0; i < sizeof(speed_cases) / sizeof(speed_cases[0]); i++) {
+            if (wanted(speed_cases[i].name, argc, argv)) run_speed(&speed_cases[i]);
+        }
+    }
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef BENCH_STRING_NAMES_H
+#define BENCH_STRING_NAMES_H
+
+// Names kernel/string.c is built under for the host string benchmark, so
+// its functions sit beside the C library's instead of replacing them.
+// Included ahead of kernel/string.c on its compile line, and by
+// string_bench.c after its system headers.
+
+#define strlen          kstr_strlen
+#define strcpy          kstr_strcpy
+#define strncpy         kstr_strncpy
+#define strcmp          kstr_strcmp
+#define strncmp         kstr_strncmp
+#define strcat          kstr_strcat
+#define strchr          kstr_strchr
+#define memchr          kstr_memchr
+#define memrchr         kstr_memrchr
+#define strstr          kstr_strstr
+#define memmem          kstr_memmem
+#define string_init     kstr_string_init
+#define string_variant  kstr_string_variant
+#define memset          kstr_memset
+#define memcpy          kstr_memcpy
+#define memmove         kstr_memmove
+#define memcmp          kstr_memcmp
+#define itoa            kstr_itoa
+#define utoa            kstr_utoa
+#define vsnprintf       kstr_vsnprintf
+#define ksnprintf       kstr_ksnprintf
+#define atoi            kstr_atoi
+#define isdigit         kstr_isdigit
+#define isalpha         kstr_isalpha
+#define isalnum         kstr_isalnum
+#define isspace         kstr_isspace
+#define toupper         kstr_toupper
+#define tolower         kstr_tolower
+
+#endif // BENCH_STRING_NAMES_H
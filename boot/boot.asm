@@ -16,7 +16,10 @@ align 4
 
 ; Stack setup
 section .bss
-align 16
+align 4096
+global stack_guard
+stack_guard:
+    resb 4096                       ; Left unmapped once paging is on
 stack_bottom:
     resb 16384                      ; 16 KB stack
 stack_top:
@@ -144,6 +147,12 @@ IRQ 12, 44                          ; PS/2 Mouse
 IRQ 13, 45                          ; FPU
 IRQ 14, 46                          ; Primary ATA
 IRQ 15, 47                          ; Secondary ATA
+IRQ 16, 48                          ; Local APIC timer
+
+; Local APIC spurious interrupt: nothing was delivered, so no EOI
+global apic_spurious
+apic_spurious:
+    iret
 
 extern isr_handler
 extern irq_handler
@@ -158,7 +167,10 @@ isr_common_stub:
     mov es, ax
     mov fs, ax
     mov gs, ax
+    cld                             ; C code expects DF clear
+    push esp                        ; registers_t* for the C handler
     call isr_handler
+    add esp, 4
     pop eax                         ; Restore data segment
     mov ds, ax
     mov es, ax
@@ -179,7 +191,10 @@ irq_common_stub:
     mov es, ax
     mov fs, ax
     mov gs, ax
+    cld
+    push esp
     call irq_handler
+    add esp, 4
     pop ebx
     mov ds, bx
     mov es, bx
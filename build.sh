@@ -55,11 +55,24 @@ $CC $CFLAGS -Ikernel -c kernel/vga.c -o build/vga.o
 $CC $CFLAGS -Ikernel -c kernel/idt.c -o build/idt.o
 $CC $CFLAGS -Ikernel -c kernel/keyboard.c -o build/keyboard.o
 $CC $CFLAGS -Ikernel -c kernel/memory.c -o build/memory.o
+$CC $CFLAGS -Ikernel -c kernel/slab.c -o build/slab.o
+$CC $CFLAGS -Ikernel -c kernel/atom.c -o build/atom.o
+$CC $CFLAGS -Ikernel -c kernel/pmm.c -o build/pmm.o
+$CC $CFLAGS -Ikernel -c kernel/paging.c -o build/paging.o
+$CC $CFLAGS -Ikernel -c kernel/dma.c -o build/dma.o
+$CC $CFLAGS -Ikernel -c kernel/acpi.c -o build/acpi.o
+$CC $CFLAGS -Ikernel -c kernel/apic.c -o build/apic.o
+$CC $CFLAGS -Ikernel -c kernel/serial.c -o build/serial.o
+$CC $CFLAGS -Ikernel -c kernel/timer.c -o build/timer.o
+$CC $CFLAGS -Ikernel -c kernel/ktimer.c -o build/ktimer.o
+$CC $CFLAGS -Ikernel -c kernel/work.c -o build/work.o
 $CC $CFLAGS -Ikernel -c kernel/audio.c -o build/audio.o
 $CC $CFLAGS -Ikernel -c kernel/disk.c -o build/disk.o
 $CC $CFLAGS -Ikernel -c kernel/network.c -o build/network.o
 $CC $CFLAGS -Ikernel -c kernel/gui.c -o build/gui.o
 $CC $CFLAGS -Ikernel -c kernel/shell.c -o build/shell.o
+$CC $CFLAGS -Ikernel -c kernel/kbench.c -o build/kbench.o
+$CC $CFLAGS -Ikernel -c kernel/benchmarks.c -o build/benchmarks.o
 $CC $CFLAGS -Ikernel -c kernel/apps/notepad.c -o build/apps/notepad.o
 $CC $CFLAGS -Ikernel -c kernel/apps/css.c -o build/apps/css.o
 $CC $CFLAGS -Ikernel -c kernel/apps/javascript.c -o build/apps/javascript.o
@@ -78,12 +91,25 @@ $LD $LDFLAGS -o build/kernel.bin \
     build/idt.o \
     build/keyboard.o \
     build/memory.o \
+    build/slab.o \
+    build/atom.o \
+    build/pmm.o \
+    build/paging.o \
+    build/dma.o \
+    build/acpi.o \
+    build/apic.o \
+    build/serial.o \
+    build/timer.o \
+    build/ktimer.o \
+    build/work.o \
     build/string.o \
     build/audio.o \
     build/disk.o \
     build/network.o \
     build/gui.o \
     build/shell.o \
+    build/kbench.o \
+    build/benchmarks.o \
     build/apps/notepad.o \
     build/apps/css.o \
     build/apps/javascript.o \
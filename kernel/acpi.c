@@ -0,0 +1,111 @@
+#include "acpi.h"
+#include "paging.h"
+#include "string.h"
+
+// Where the BIOS leaves the RSDP: the first KB of the EBDA, whose segment
+// is stored at 0x40E, or the read-only BIOS area below 1 MB
+#define BIOS_EBDA_SEGMENT 0x40E
+#define BIOS_AREA_START   0xE0000
+#define BIOS_AREA_END     0x100000
+
+// Root System Description Pointer
+typedef struct {
+    char signature[8];        // "RSD PTR "
+    uint8_t checksum;         // Over the first 20 bytes
+    char oem_id[6];
+    uint8_t revision;         // 0 for ACPI 1.0, 2 and up has the XSDT
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+// Root table: the RSDT holds 32-bit table pointers, the XSDT 64-bit ones
+static const acpi_header_t* root = NULL;
+static bool root_is_xsdt = false;
+
+static bool checksum_ok(const void* data, uint32_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += p[i];
+    }
+    return sum == 0;
+}
+
+static const acpi_rsdp_t* scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + 20 <= end; addr += 16) {
+        const acpi_rsdp_t* rsdp = (const acpi_rsdp_t*)addr;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 && checksum_ok(rsdp, 20)) {
+            return rsdp;
+        }
+    }
+    return NULL;
+}
+
+// Map a table in two steps, the header to learn its length and then the
+// rest; NULL if it can't be mapped or fails its checksum
+static const acpi_header_t* map_table(uint64_t phys) {
+    if (phys == 0 || phys >= 0x100000000ull) return NULL;
+
+    uint32_t addr = (uint32_t)phys;
+    if (!paging_identity_map(addr, sizeof(acpi_header_t), 0)) return NULL;
+
+    const acpi_header_t* header = (const acpi_header_t*)addr;
+    if (header->length < sizeof(acpi_header_t)) return NULL;
+    if (!paging_identity_map(addr, header->length, 0)) return NULL;
+    return checksum_ok(header, header->length) ? header : NULL;
+}
+
+bool acpi_init(void) {
+    // Hide the address from GCC, which takes loads from the first page
+    // for NULL dereferences
+    uint32_t bda = BIOS_EBDA_SEGMENT;
+    __asm__ ("" : "+r"(bda));
+    uint32_t ebda = (uint32_t)(*(const uint16_t*)bda) << 4;
+    const acpi_rsdp_t* rsdp = NULL;
+
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        rsdp = scan_rsdp(ebda, ebda + 1024);
+    }
+    if (rsdp == NULL) {
+        rsdp = scan_rsdp(BIOS_AREA_START, BIOS_AREA_END);
+    }
+    if (rsdp == NULL) return false;
+
+    // Prefer the XSDT when the RSDP is new enough to have one
+    if (rsdp->revision >= 2 && checksum_ok(rsdp, rsdp->length)) {
+        root = map_table(rsdp->xsdt_address);
+        root_is_xsdt = root != NULL;
+    }
+    if (root == NULL) {
+        root = map_table(rsdp->rsdt_address);
+    }
+    return root != NULL;
+}
+
+const acpi_header_t* acpi_find_table(const char* signature) {
+    if (root == NULL) return NULL;
+
+    const uint8_t* entries = (const uint8_t*)root + sizeof(acpi_header_t);
+    uint32_t entry_size = root_is_xsdt ? 8 : 4;
+    uint32_t count = (root->length - sizeof(acpi_header_t)) / entry_size;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t phys;
+        if (root_is_xsdt) {
+            memcpy(&phys, entries + i * 8, 8);
+        } else {
+            uint32_t addr32;
+            memcpy(&addr32, entries + i * 4, 4);
+            phys = addr32;
+        }
+
+        const acpi_header_t* table = map_table(phys);
+        if (table && memcmp(table->signature, signature, 4) == 0) {
+            return table;
+        }
+    }
+    return NULL;
+}
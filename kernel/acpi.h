@@ -0,0 +1,30 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ACPI table discovery. Only finding tables is handled here; their
+// users (the APIC code reads the MADT) parse them.
+
+// Header every system description table starts with
+typedef struct {
+    char signature[4];
+    uint32_t length;          // Whole table, header included
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_header_t;
+
+// Find the RSDP and root table; call after paging_init
+bool acpi_init(void);
+
+// Table with the given four-letter signature whose checksum is valid,
+// mapped and ready to read, or NULL
+const acpi_header_t* acpi_find_table(const char* signature);
+
+#endif // ACPI_H
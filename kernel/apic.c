@@ -0,0 +1,252 @@
+#include "apic.h"
+#include "acpi.h"
+#include "cpu.h"
+#include "io.h"
+#include "paging.h"
+#include "string.h"
+
+// Local APIC registers (offsets from its base)
+#define LAPIC_ID         0x020
+#define LAPIC_TPR        0x080      // Task priority
+#define LAPIC_EOI        0x0B0
+#define LAPIC_SVR        0x0F0      // Spurious vector; bit 8 enables
+#define LAPIC_LVT_TIMER  0x320
+#define LAPIC_LVT_LINT0  0x350
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CUR  0x390
+#define LAPIC_TIMER_DIV  0x3E0
+
+#define LAPIC_SVR_ENABLE (1u << 8)
+#define LAPIC_LVT_MASKED (1u << 16)
+#define LAPIC_DIV_16     0x3
+
+// I/O APIC registers: select one through IOREGSEL, then use IOWIN
+#define IOAPIC_REGSEL    0x00
+#define IOAPIC_WIN       0x10
+#define IOAPIC_VER       0x01
+#define IOAPIC_REDIR(n)  (0x10 + 2 * (n))
+
+#define IOAPIC_ACTIVE_LOW (1u << 13)
+#define IOAPIC_LEVEL      (1u << 15)
+#define IOAPIC_MASKED     (1u << 16)
+
+// MADT entry types and interrupt source override flags
+#define MADT_LAPIC          0
+#define MADT_IOAPIC         1
+#define MADT_OVERRIDE       2
+#define MADT_LAPIC_ADDRESS  5
+#define MADT_POLARITY_LOW   0x3
+#define MADT_TRIGGER_LEVEL  0xC
+
+#define ISA_IRQS   16
+#define IRQ_VECTOR 32
+
+// isa_gsi entry for an IRQ with no pin of its own
+#define NO_GSI     0xFFFFFFFFu
+
+typedef struct {
+    acpi_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__((packed)) madt_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) madt_entry_t;
+
+typedef struct {
+    volatile uint32_t* base;
+    uint32_t gsi_base;
+    uint32_t pins;
+} ioapic_t;
+
+static apic_info_t info;
+static volatile uint32_t* lapic = NULL;
+static ioapic_t ioapics[APIC_MAX_IOAPICS];
+
+// Where each ISA IRQ lands and the redirection flags it needs
+static uint32_t isa_gsi[ISA_IRQS];
+static uint32_t isa_flags[ISA_IRQS];
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+static uint32_t ioapic_read(const ioapic_t* io, uint32_t reg) {
+    io->base[IOAPIC_REGSEL / 4] = reg;
+    return io->base[IOAPIC_WIN / 4];
+}
+
+static void ioapic_write(const ioapic_t* io, uint32_t reg, uint32_t value) {
+    io->base[IOAPIC_REGSEL / 4] = reg;
+    io->base[IOAPIC_WIN / 4] = value;
+}
+
+// I/O APIC serving a global system interrupt, with the pin in *pin
+static const ioapic_t* ioapic_for(uint32_t gsi, uint32_t* pin) {
+    for (int i = 0; i < info.ioapic_count; i++) {
+        if (gsi >= ioapics[i].gsi_base && gsi < ioapics[i].gsi_base + ioapics[i].pins) {
+            *pin = gsi - ioapics[i].gsi_base;
+            return &ioapics[i];
+        }
+    }
+    return NULL;
+}
+
+static bool add_ioapic(uint32_t address, uint32_t gsi_base) {
+    if (info.ioapic_count == APIC_MAX_IOAPICS) return true;
+    if (!paging_identity_map(address, 4096, PTE_WRITE | PTE_PCD | PTE_PWT)) return false;
+
+    ioapic_t* io = &ioapics[info.ioapic_count++];
+    io->base = (volatile uint32_t*)address;
+    io->gsi_base = gsi_base;
+    io->pins = ((ioapic_read(io, IOAPIC_VER) >> 16) & 0xFF) + 1;
+    info.gsi_count += io->pins;
+    return true;
+}
+
+// Read the local APIC address, I/O APICs and ISA overrides from the MADT
+static bool parse_madt(const madt_t* madt) {
+    const uint8_t* p = (const uint8_t*)madt + sizeof(madt_t);
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+
+    info.lapic_base = madt->lapic_address;
+    while (p + sizeof(madt_entry_t) <= end) {
+        const madt_entry_t* entry = (const madt_entry_t*)p;
+        if (entry->length < sizeof(madt_entry_t) || p + entry->length > end) break;
+
+        switch (entry->type) {
+            case MADT_LAPIC:
+                if (p[4] & 1) info.cpu_count++;     // Enabled flag
+                break;
+            case MADT_IOAPIC: {
+                uint32_t address, gsi_base;
+                memcpy(&address, p + 4, 4);
+                memcpy(&gsi_base, p + 8, 4);
+                if (!add_ioapic(address, gsi_base)) return false;
+                break;
+            }
+            case MADT_OVERRIDE: {
+                uint8_t irq = p[3];
+                uint32_t gsi;
+                uint16_t flags;
+                memcpy(&gsi, p + 4, 4);
+                memcpy(&flags, p + 8, 2);
+                if (irq < ISA_IRQS) {
+                    isa_gsi[irq] = gsi;
+                    isa_flags[irq] = 0;
+                    if ((flags & MADT_POLARITY_LOW) == MADT_POLARITY_LOW) isa_flags[irq] |= IOAPIC_ACTIVE_LOW;
+                    if ((flags & MADT_TRIGGER_LEVEL) == MADT_TRIGGER_LEVEL) isa_flags[irq] |= IOAPIC_LEVEL;
+                    info.override_count++;
+                }
+                break;
+            }
+            case MADT_LAPIC_ADDRESS: {
+                uint64_t address;
+                memcpy(&address, p + 4, 8);
+                if (address < 0x100000000ull) info.lapic_base = (uint32_t)address;
+                break;
+            }
+        }
+        p += entry->length;
+    }
+    return info.ioapic_count > 0;
+}
+
+bool apic_init(void) {
+    uint32_t edx = cpu_features_edx();
+    if (!(edx & CPUID_EDX_APIC) || !(edx & CPUID_EDX_MSR)) return false;
+    if (!acpi_init()) return false;
+
+    const madt_t* madt = (const madt_t*)acpi_find_table("APIC");
+    if (madt == NULL) return false;
+
+    // ISA IRQs are edge-triggered, active high, and wired 1:1 unless the
+    // MADT says otherwise
+    for (int irq = 0; irq < ISA_IRQS; irq++) {
+        isa_gsi[irq] = irq;
+        isa_flags[irq] = 0;
+    }
+    if (!parse_madt(madt)) return false;
+
+    // An override moves an IRQ onto another IRQ's pin (IRQ 0 onto GSI 2
+    // nearly everywhere); the IRQ that would have used that pin 1:1 gets
+    // none, or routing it would overwrite the override's entry
+    for (int irq = 0; irq < ISA_IRQS; irq++) {
+        if (isa_gsi[irq] != (uint32_t)irq) continue;
+        for (int other = 0; other < ISA_IRQS; other++) {
+            if (other != irq && isa_gsi[other] == (uint32_t)irq) {
+                isa_gsi[irq] = NO_GSI;
+                break;
+            }
+        }
+    }
+    if (!paging_identity_map(info.lapic_base, 4096, PTE_WRITE | PTE_PCD | PTE_PWT)) return false;
+
+    // Silence the 8259s; they stay remapped to 32-47 so a spurious IRQ
+    // from them still lands on a harmless vector
+    outb(0x21, 0xFF);
+    outb(0xA1, 0xFF);
+
+    wrmsr(MSR_APIC_BASE, (rdmsr(MSR_APIC_BASE) & ~0xFFFull) | MSR_APIC_BASE_ENABLE);
+    lapic = (volatile uint32_t*)info.lapic_base;
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_TPR, 0);                          // Accept every class
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);      // No 8259 virtual wire
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+    info.lapic_id = (uint8_t)(lapic_read(LAPIC_ID) >> 24);
+
+    // Route every ISA IRQ to this CPU on its old vector, masked until a
+    // driver unmasks it
+    for (int irq = 0; irq < ISA_IRQS; irq++) {
+        uint32_t pin;
+        const ioapic_t* io = ioapic_for(isa_gsi[irq], &pin);
+        if (io == NULL) continue;
+        ioapic_write(io, IOAPIC_REDIR(pin) + 1, (uint32_t)info.lapic_id << 24);
+        ioapic_write(io, IOAPIC_REDIR(pin), IOAPIC_MASKED | isa_flags[irq] | (IRQ_VECTOR + irq));
+    }
+
+    info.enabled = true;
+    return true;
+}
+
+bool apic_enabled(void) {
+    return info.enabled;
+}
+
+void apic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+void apic_set_irq_masked(int irq, bool masked) {
+    if (!info.enabled || irq < 0 || irq >= ISA_IRQS) return;
+
+    uint32_t pin;
+    const ioapic_t* io = ioapic_for(isa_gsi[irq], &pin);
+    if (io == NULL) return;
+
+    uint32_t low = ioapic_read(io, IOAPIC_REDIR(pin));
+    low = masked ? (low | IOAPIC_MASKED) : (low & ~IOAPIC_MASKED);
+    ioapic_write(io, IOAPIC_REDIR(pin), low);
+}
+
+void apic_timer_start(uint32_t count, bool masked) {
+    // One-shot mode (timer mode bits clear)
+    lapic_write(LAPIC_LVT_TIMER, (masked ? LAPIC_LVT_MASKED : 0) | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, count);
+}
+
+uint32_t apic_timer_remaining(void) {
+    return lapic_read(LAPIC_TIMER_CUR);
+}
+
+void apic_get_info(apic_info_t* out) {
+    if (out == NULL) return;
+    *out = info;
+}
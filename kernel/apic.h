@@ -0,0 +1,52 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Local APIC and I/O APIC interrupt delivery. When apic_init succeeds
+// the 8259 PICs are masked and ISA IRQs 0-15 arrive through the I/O APIC
+// on the same vectors (32-47) as before, so IRQ handlers don't change.
+// The local APIC's priority follows the vector: the timer (48) sits in a
+// class above the ISA lines.
+
+#define APIC_TIMER_VECTOR    48
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+#define APIC_MAX_IOAPICS     4
+
+// What apic_init found
+typedef struct {
+    bool enabled;
+    uint32_t lapic_base;      // Physical address of the local APIC
+    uint8_t lapic_id;         // Local APIC of the boot CPU
+    int cpu_count;            // Enabled processors in the MADT
+    int ioapic_count;
+    int gsi_count;            // Interrupt pins over all I/O APICs
+    int override_count;       // ISA IRQs the MADT reroutes
+} apic_info_t;
+
+// Switch from the 8259s to the APICs if the CPU has a local APIC and the
+// ACPI MADT lists an I/O APIC; call after paging_init and idt_init
+bool apic_init(void);
+
+// Whether interrupts are coming through the APICs
+bool apic_enabled(void);
+
+// Acknowledge the interrupt being handled
+void apic_eoi(void);
+
+// Mask or unmask an ISA IRQ at the I/O APIC
+void apic_set_irq_masked(int irq, bool masked);
+
+// Start the local APIC timer counting down from count; it raises
+// APIC_TIMER_VECTOR once at zero unless masked
+void apic_timer_start(uint32_t count, bool masked);
+
+// Current count of the local APIC timer
+uint32_t apic_timer_remaining(void);
+
+// Get what apic_init found
+void apic_get_info(apic_info_t* info);
+
+#endif // APIC_H
@@ -16,24 +16,19 @@
 
 static browser_state_t g;
 
+// Per-page allocations. The layout arena holds the DOM, links and CSS
+// rules and is rebuilt on every render; the page arena holds script state
+// and lives until the next page is loaded. Both sit outside g so
+// browser_init's memset doesn't drop them.
+#define BROWSER_ARENA_CHUNK 16384
+static arena_t* layout_arena = NULL;
+static arena_t* page_arena = NULL;
+
 // --- Small utilities ---
 static bool starts_with(const char* s, const char* prefix) {
     return strncmp(s, prefix, strlen(prefix)) == 0;
 }
 
-static const char* find_substr(const char* hay, const char* needle) {
-    if (!hay || !needle || !*needle) return hay;
-    size_t nlen = strlen(needle);
-    for (const char* p = hay; *p; p++) {
-        // Early exit if remaining shorter than needle
-        const char* q = p;
-        size_t i = 0;
-        while (q[i] && i < nlen && q[i] == needle[i]) i++;
-        if (i == nlen) return p;
-    }
-    return 0;
-}
-
 static void safe_strcpy(char* dst, const char* src, size_t max) {
     if (!dst || !src || max == 0) return;
     strncpy(dst, src, max - 1);
@@ -64,9 +59,9 @@ static js_dom_element_t* js_cb_get_el(const char* id) {
     // Static to keep lifetime; minimal and shared for simplicity
     static js_dom_element_t js_el;
     memset(&js_el, 0, sizeof(js_el));
-    safe_strcpy(js_el.tag, el->tag, sizeof(js_el.tag));
-    safe_strcpy(js_el.id, el->id, sizeof(js_el.id));
-    safe_strcpy(js_el.class_name, el->class_name, sizeof(js_el.class_name));
+    js_el.tag = el->tag;
+    js_el.id = el->id;
+    js_el.class_name = el->class_name;
     safe_strcpy(js_el.inner_text, el->inner_text, sizeof(js_el.inner_text));
     safe_strcpy(js_el.style, el->style, sizeof(js_el.style));
     js_el.visible = el->visible;
@@ -182,7 +177,9 @@ static void output_text(draw_cursor_t* c, const char* text) {
 
 static void add_link(int x, int line_no, const char* url, const char* onclick, int length) {
     if (g.link_count >= BROWSER_MAX_LINKS) return;
-    browser_link_t* L = &g.links[g.link_count++];
+    browser_link_t* L = (browser_link_t*)arena_alloc(layout_arena, sizeof(browser_link_t));
+    if (!L) return;
+    g.links[g.link_count++] = L;
     L->x = x; L->y = line_no; L->length = length;
     safe_strcpy(L->url, url ? url : "", sizeof(L->url));
     safe_strcpy(L->onclick, onclick ? onclick : "", sizeof(L->onclick));
@@ -196,28 +193,38 @@ static void reset_dom(void) {
     g.element_count = 0;
 }
 
-static void add_dom_element(const char* tag, const char* id, const char* cls, const char* text, const char* style, int line_no, int x) {
+static void add_dom_element(atom_t tag, atom_t id, atom_t cls, const char* text, const char* style, int line_no, int x) {
     if (g.element_count >= BROWSER_MAX_ELEMENTS) return;
-    dom_element_t* e = &g.elements[g.element_count++];
+    dom_element_t* e = (dom_element_t*)arena_alloc(layout_arena, sizeof(dom_element_t));
+    if (!e) return;
+    g.elements[g.element_count++] = e;
     memset(e, 0, sizeof(*e));
-    safe_strcpy(e->tag, tag ? tag : "", sizeof(e->tag));
-    safe_strcpy(e->id, id ? id : "", sizeof(e->id));
-    safe_strcpy(e->class_name, cls ? cls : "", sizeof(e->class_name));
+    e->tag = tag;
+    e->id = id;
+    e->class_name = cls;
     safe_strcpy(e->inner_text, text ? text : "", sizeof(e->inner_text));
     safe_strcpy(e->style, style ? style : "", sizeof(e->style));
     e->line = line_no; e->x = x; e->visible = true;
 }
 
-static void apply_style_for(const char* tag, const char* cls, const char* id, const char* inline_style) {
+// Atom for the tag name at the start of a tag's source; a tag nothing
+// refers to has no atom and gets ATOM_NONE
+static atom_t tag_atom(const char* tagname) {
+    size_t len = 0;
+    while (isalnum(tagname[len])) len++;
+    return atom_find_len(tagname, len);
+}
+
+static void apply_style_for(atom_t tag, atom_t cls, atom_t id, const char* inline_style) {
     css_computed_style_t s;
-    css_compute_style(tag ? tag : "", cls ? cls : "", id ? id : "", inline_style ? inline_style : "", &g.stylesheet, &s);
+    css_compute_style(tag, cls, id, inline_style ? inline_style : "", &g.stylesheet, &s);
     css_apply_style(&s);
 }
 
 // Very small attribute parser: extracts value for given attribute name inside tag like: name="value"
 static void parse_attr(const char* tag_src, const char* name, char* out, size_t outsz) {
     out[0] = '\0';
-    const char* p = find_substr(tag_src, name);
+    const char* p = strstr(tag_src, name);
     if (!p) return;
     p += strlen(name);
     while (*p == ' ' || *p == '=') { if (*p == '=') { p++; break; } p++; }
@@ -231,6 +238,9 @@ static void parse_attr(const char* tag_src, const char* name, char* out, size_t
 // Parse <style>...</style> and <script>...</script>, simple tags and text.
 static void render_html(void) {
     uint8_t default_color = vga_get_color();
+    // Everything built by the previous render goes at once
+    arena_reset(layout_arena);
+    css_reset_stylesheet(&g.stylesheet);
     clear_links();
     reset_dom();
     // Clear content area
@@ -240,7 +250,8 @@ static void render_html(void) {
 
     draw_cursor_t cur; cur.line_no = 0; cur.x = 0;
 
-    const char* p = g.html_content;
+    const char* html = (const char*)hlock(g.html_handle);
+    const char* p = html ? html : "";
     while (*p) {
         if (*p == '<') {
             // read tag
@@ -261,7 +272,7 @@ static void render_html(void) {
                 if (starts_with(tagname, "style")) {
                     // Collect until </style>
                     const char* body_start = tag_end + 1;
-                    const char* close = find_substr(body_start, "</style>");
+                    const char* close = strstr(body_start, "</style>");
                     if (!close) close = body_start;
                     char cssbuf[512];
                     size_t blen = (size_t)(close - body_start);
@@ -273,7 +284,7 @@ static void render_html(void) {
                 }
                 if (starts_with(tagname, "script")) {
                     const char* body_start = tag_end + 1;
-                    const char* close = find_substr(body_start, "</script>");
+                    const char* close = strstr(body_start, "</script>");
                     if (!close) close = body_start;
                     char jsbuf[512];
                     size_t blen = (size_t)(close - body_start);
@@ -297,7 +308,7 @@ static void render_html(void) {
                     // newline before block
                     if (cur.x != 0) { output_char(&cur, '\n'); }
                     // Apply style
-                    apply_style_for(tagname, "", "", "");
+                    apply_style_for(tag_atom(tagname), ATOM_NONE, ATOM_NONE, "");
                     p = tag_end + 1;
                     continue;
                 }
@@ -308,7 +319,7 @@ static void render_html(void) {
                 if (starts_with(tagname, "span")) {
                     char style_attr[256]; style_attr[0] = '\0';
                     parse_attr(tagbuf, "style", style_attr, sizeof(style_attr));
-                    apply_style_for("span", "", "", style_attr);
+                    apply_style_for(ATOM_SPAN, ATOM_NONE, ATOM_NONE, style_attr);
                     p = tag_end + 1; continue;
                 }
                 if (starts_with(tagname, "a")) {
@@ -319,16 +330,16 @@ static void render_html(void) {
                     parse_attr(tagbuf, "onclick", onclick, sizeof(onclick));
                     // Store as a temporary marker in DOM: We'll add after we read text content until </a>
                     const char* text_start = tag_end + 1;
-                    const char* close = find_substr(text_start, "</a>");
+                    const char* close = strstr(text_start, "</a>");
                     if (!close) close = text_start;
                     int link_len = 0;
                     // Count visible text length
                     for (const char* q = text_start; q < close; q++) if (*q != '\n' && *q != '\r' && *q != '\t') link_len++;
                     // Add DOM element and link
-                    add_dom_element("a", "", "", "", "", cur.line_no, cur.x);
+                    add_dom_element(ATOM_A, ATOM_NONE, ATOM_NONE, "", "", cur.line_no, cur.x);
                     add_link(cur.x, cur.line_no, href, onclick, link_len);
                     // Render with underline-style coloring
-                    css_computed_style_t s; css_get_default_style("a", &s); s.underline = true; css_apply_style(&s);
+                    css_computed_style_t s; css_get_default_style(ATOM_A, &s); s.underline = true; css_apply_style(&s);
                     // Emit text
                     for (const char* q = text_start; q < close; q++) {
                         char ch = *q;
@@ -360,10 +371,11 @@ static void render_html(void) {
     }
 
     g.total_lines = cur.line_no + 1;
+    hunlock(g.html_handle);
 
     // Highlight current link on screen
     if (g.link_count > 0 && g.current_link >= 0 && g.current_link < g.link_count) {
-        browser_link_t* L = &g.links[g.current_link];
+        browser_link_t* L = g.links[g.current_link];
         int screen_y = CONTENT_START_Y + (L->y - g.view_offset);
         if (screen_y >= CONTENT_START_Y && screen_y < STATUSBAR_Y) {
             uint8_t old = vga_get_color();
@@ -380,9 +392,17 @@ static void render_html(void) {
 
 // --- Public API ---
 void browser_init(void) {
+    if (!layout_arena) layout_arena = arena_create(BROWSER_ARENA_CHUNK);
+    if (!page_arena) page_arena = arena_create(BROWSER_ARENA_CHUNK);
+    arena_reset(layout_arena);
+    arena_reset(page_arena);
+
+    hfree(g.html_handle);
     memset(&g, 0, sizeof(g));
     css_reset_stylesheet(&g.stylesheet);
+    css_set_arena(&g.stylesheet, layout_arena);
     js_init(&g.js_context);
+    js_set_arena(&g.js_context, page_arena);
     js_set_alert_callback(&g.js_context, js_cb_alert);
     js_set_console_callback(&g.js_context, js_cb_console);
     js_set_dom_callbacks(&g.js_context, js_cb_get_el, js_cb_set_el);
@@ -443,7 +463,16 @@ void browser_run(void) {
             default:
                 if (ev.ascii == 'c') { browser_toggle_console(); browser_render(); }
                 else if (ev.ascii == 'h') { browser_home(); browser_render(); }
-                else if (ev.ascii == 'r') { browser_load_html(g.html_content); browser_render(); }
+                else if (ev.ascii == 'r') {
+                    // Take the page over so loading it again doesn't try to
+                    // free it while it is pinned
+                    handle_t page = g.html_handle;
+                    g.html_handle = 0;
+                    browser_load_html((const char*)hlock(page));
+                    hunlock(page);
+                    hfree(page);
+                    browser_render();
+                }
                 else if (ev.ascii == 's') { browser_stop_audio(); browser_render(); }
                 break;
         }
@@ -451,22 +480,34 @@ void browser_run(void) {
 }
 
 void browser_load_html(const char* html) {
-    memset(g.html_content, 0, sizeof(g.html_content));
-    g.html_length = 0;
-    if (html) {
-        safe_strcpy(g.html_content, html, sizeof(g.html_content));
-        g.html_length = strlen(g.html_content);
+    // Copy into a new buffer before dropping the old one. A reload passes
+    // the current page pinned, so it takes g.html_handle over first: hfree
+    // leaves a locked handle alone.
+    size_t len = html ? strlen(html) : 0;
+    if (len >= BROWSER_MAX_HTML_SIZE) len = BROWSER_MAX_HTML_SIZE - 1;
+    handle_t page = hmalloc(len + 1);
+    char* buf = (char*)hlock(page);
+    if (buf) {
+        memcpy(buf, html, len);
+        buf[len] = '\0';
     }
+    hfree(g.html_handle);
+    g.html_handle = page;
+    g.html_length = buf ? (int)len : 0;
+
     // Reset state for new page
+    arena_reset(layout_arena);
+    arena_reset(page_arena);
     css_reset_stylesheet(&g.stylesheet);
+    js_reset(&g.js_context);
     g.view_offset = 0;
     g.total_lines = 0;
     clear_links();
     reset_dom();
 
     // Auto-extract <title>
-    const char* t1 = find_substr(g.html_content, "<title>");
-    const char* t2 = t1 ? find_substr(t1 + 7, "</title>") : 0;
+    const char* t1 = buf ? strstr(buf, "<title>") : 0;
+    const char* t2 = t1 ? strstr(t1 + 7, "</title>") : 0;
     if (t1 && t2) {
         char tb[128]; size_t n = (size_t)(t2 - (t1 + 7)); if (n >= sizeof(tb)) n = sizeof(tb) - 1;
         memcpy(tb, t1 + 7, n); tb[n] = '\0';
@@ -474,6 +515,7 @@ void browser_load_html(const char* html) {
     } else {
         safe_strcpy(g.page_title, "MiniOS Browser", sizeof(g.page_title));
     }
+    hunlock(page);
 }
 
 void browser_navigate(const char* url) {
@@ -562,7 +604,7 @@ void browser_next_link(void) {
     if (g.link_count == 0) return;
     g.current_link = (g.current_link + 1) % g.link_count;
     // Auto-scroll if needed
-    browser_link_t* L = &g.links[g.current_link];
+    browser_link_t* L = g.links[g.current_link];
     if (L->y < g.view_offset) g.view_offset = L->y;
     int bottom = g.view_offset + CONTENT_HEIGHT - 1;
     if (L->y > bottom) g.view_offset = L->y - CONTENT_HEIGHT + 1;
@@ -572,7 +614,7 @@ void browser_prev_link(void) {
     if (g.link_count == 0) return;
     g.current_link = (g.current_link - 1);
     if (g.current_link < 0) g.current_link = g.link_count - 1;
-    browser_link_t* L = &g.links[g.current_link];
+    browser_link_t* L = g.links[g.current_link];
     if (L->y < g.view_offset) g.view_offset = L->y;
     int bottom = g.view_offset + CONTENT_HEIGHT - 1;
     if (L->y > bottom) g.view_offset = L->y - CONTENT_HEIGHT + 1;
@@ -580,7 +622,7 @@ void browser_prev_link(void) {
 
 void browser_activate_link(void) {
     if (g.link_count == 0) return;
-    browser_link_t* L = &g.links[g.current_link];
+    browser_link_t* L = g.links[g.current_link];
     if (L->onclick[0]) {
         browser_execute_js(L->onclick);
     } else if (L->url[0]) {
@@ -600,9 +642,11 @@ void browser_execute_js(const char* code) {
 }
 
 dom_element_t* browser_get_element_by_id(const char* id) {
-    if (!id || !id[0]) return 0;
+    // An id nothing was ever given has no atom, so can't match
+    atom_t atom = atom_find(id);
+    if (atom == ATOM_NONE) return 0;
     for (int i = 0; i < g.element_count; i++) {
-        if (strcmp(g.elements[i].id, id) == 0) return &g.elements[i];
+        if (g.elements[i]->id == atom) return g.elements[i];
     }
     return 0;
 }
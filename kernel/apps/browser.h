@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include "css.h"
 #include "javascript.h"
+#include "../memory.h"
 
 // Maximum sizes
 #define BROWSER_MAX_HTML_SIZE 16384
@@ -23,9 +24,9 @@ typedef struct {
 
 // DOM element for JavaScript interaction
 typedef struct {
-    char tag[32];
-    char id[64];
-    char class_name[64];
+    atom_t tag;
+    atom_t id;
+    atom_t class_name;
     char inner_text[256];
     char style[256];
     int line;
@@ -43,8 +44,8 @@ typedef struct {
 
 // Browser state
 typedef struct {
-    // HTML content
-    char html_content[BROWSER_MAX_HTML_SIZE];
+    // HTML content, kept in movable memory and locked while in use
+    handle_t html_handle;
     int html_length;
     
     // CSS stylesheet
@@ -53,12 +54,12 @@ typedef struct {
     // JavaScript context
     js_context_t js_context;
     
-    // DOM elements
-    dom_element_t elements[BROWSER_MAX_ELEMENTS];
+    // DOM elements (allocated from the layout arena)
+    dom_element_t* elements[BROWSER_MAX_ELEMENTS];
     int element_count;
     
-    // Links
-    browser_link_t links[BROWSER_MAX_LINKS];
+    // Links (allocated from the layout arena)
+    browser_link_t* links[BROWSER_MAX_LINKS];
     int link_count;
     int current_link;
     
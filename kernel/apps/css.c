@@ -2,9 +2,6 @@
 #include "../string.h"
 #include "../memory.h"
 
-// Forward declaration
-static const char* css_strstr(const char* haystack, const char* needle);
-
 // CSS color name to VGA color mapping
 static const css_color_map_t color_map[] = {
     {"black", VGA_COLOR_BLACK},
@@ -178,23 +175,25 @@ uint8_t css_color_to_vga(const char* color) {
 }
 
 css_property_type_t css_parse_property_name(const char* name) {
-    if (strcmp(name, "color") == 0) return CSS_PROP_COLOR;
-    if (strcmp(name, "background-color") == 0) return CSS_PROP_BACKGROUND_COLOR;
-    if (strcmp(name, "background") == 0) return CSS_PROP_BACKGROUND_COLOR;
-    if (strcmp(name, "font-weight") == 0) return CSS_PROP_FONT_WEIGHT;
-    if (strcmp(name, "font-style") == 0) return CSS_PROP_FONT_STYLE;
-    if (strcmp(name, "text-decoration") == 0) return CSS_PROP_TEXT_DECORATION;
-    if (strcmp(name, "text-align") == 0) return CSS_PROP_TEXT_ALIGN;
-    if (strcmp(name, "display") == 0) return CSS_PROP_DISPLAY;
-    if (strcmp(name, "margin") == 0) return CSS_PROP_MARGIN;
-    if (strcmp(name, "padding") == 0) return CSS_PROP_PADDING;
-    if (strcmp(name, "border") == 0) return CSS_PROP_BORDER;
-    if (strcmp(name, "width") == 0) return CSS_PROP_WIDTH;
-    if (strcmp(name, "height") == 0) return CSS_PROP_HEIGHT;
-    return CSS_PROP_UNKNOWN;
+    switch (atom_find(name)) {
+        case ATOM_COLOR:            return CSS_PROP_COLOR;
+        case ATOM_BACKGROUND_COLOR: return CSS_PROP_BACKGROUND_COLOR;
+        case ATOM_BACKGROUND:       return CSS_PROP_BACKGROUND_COLOR;
+        case ATOM_FONT_WEIGHT:      return CSS_PROP_FONT_WEIGHT;
+        case ATOM_FONT_STYLE:       return CSS_PROP_FONT_STYLE;
+        case ATOM_TEXT_DECORATION:  return CSS_PROP_TEXT_DECORATION;
+        case ATOM_TEXT_ALIGN:       return CSS_PROP_TEXT_ALIGN;
+        case ATOM_DISPLAY:          return CSS_PROP_DISPLAY;
+        case ATOM_MARGIN:           return CSS_PROP_MARGIN;
+        case ATOM_PADDING:          return CSS_PROP_PADDING;
+        case ATOM_BORDER:           return CSS_PROP_BORDER;
+        case ATOM_WIDTH:            return CSS_PROP_WIDTH;
+        case ATOM_HEIGHT:           return CSS_PROP_HEIGHT;
+        default:                    return CSS_PROP_UNKNOWN;
+    }
 }
 
-void css_get_default_style(const char* tag_name, css_computed_style_t* style) {
+void css_get_default_style(atom_t tag, css_computed_style_t* style) {
     // Initialize with defaults
     style->color = VGA_COLOR_LIGHT_GREY;
     style->background_color = VGA_COLOR_BLACK;
@@ -209,85 +208,93 @@ void css_get_default_style(const char* tag_name, css_computed_style_t* style) {
     style->is_block = false;
     style->is_hidden = false;
     
-    if (!tag_name) return;
-    
     // Set defaults based on tag
-    if (strcmp(tag_name, "h1") == 0) {
-        style->color = VGA_COLOR_LIGHT_CYAN;
-        style->bold = true;
-        style->is_block = true;
-        style->margin_top = 1;
-        style->margin_bottom = 1;
-    }
-    else if (strcmp(tag_name, "h2") == 0) {
-        style->color = VGA_COLOR_LIGHT_GREEN;
-        style->bold = true;
-        style->is_block = true;
-        style->margin_top = 1;
-        style->margin_bottom = 1;
-    }
-    else if (strcmp(tag_name, "h3") == 0) {
-        style->color = VGA_COLOR_LIGHT_BROWN;
-        style->bold = true;
-        style->is_block = true;
-    }
-    else if (strcmp(tag_name, "h4") == 0 || strcmp(tag_name, "h5") == 0 || strcmp(tag_name, "h6") == 0) {
-        style->color = VGA_COLOR_WHITE;
-        style->bold = true;
-        style->is_block = true;
-    }
-    else if (strcmp(tag_name, "p") == 0) {
-        style->is_block = true;
-        style->margin_bottom = 1;
-    }
-    else if (strcmp(tag_name, "div") == 0) {
-        style->is_block = true;
-    }
-    else if (strcmp(tag_name, "span") == 0) {
-        style->is_block = false;
-    }
-    else if (strcmp(tag_name, "a") == 0) {
-        style->color = VGA_COLOR_LIGHT_MAGENTA;
-        style->underline = true;
-    }
-    else if (strcmp(tag_name, "strong") == 0 || strcmp(tag_name, "b") == 0) {
-        style->bold = true;
-        style->color = VGA_COLOR_WHITE;
-    }
-    else if (strcmp(tag_name, "em") == 0 || strcmp(tag_name, "i") == 0) {
-        style->italic = true;
-    }
-    else if (strcmp(tag_name, "u") == 0) {
-        style->underline = true;
-    }
-    else if (strcmp(tag_name, "code") == 0 || strcmp(tag_name, "pre") == 0) {
-        style->color = VGA_COLOR_LIGHT_GREEN;
-        style->background_color = VGA_COLOR_DARK_GREY;
-    }
-    else if (strcmp(tag_name, "blockquote") == 0) {
-        style->color = VGA_COLOR_CYAN;
-        style->is_block = true;
-        style->margin_left = 4;
-    }
-    else if (strcmp(tag_name, "ul") == 0 || strcmp(tag_name, "ol") == 0) {
-        style->is_block = true;
-        style->margin_left = 2;
-    }
-    else if (strcmp(tag_name, "li") == 0) {
-        style->is_block = true;
-        style->color = VGA_COLOR_CYAN;
-    }
-    else if (strcmp(tag_name, "hr") == 0) {
-        style->is_block = true;
-        style->color = VGA_COLOR_DARK_GREY;
-    }
-    else if (strcmp(tag_name, "button") == 0) {
-        style->color = VGA_COLOR_BLACK;
-        style->background_color = VGA_COLOR_LIGHT_GREY;
-    }
-    else if (strcmp(tag_name, "input") == 0) {
-        style->color = VGA_COLOR_WHITE;
-        style->background_color = VGA_COLOR_BLUE;
+    switch (tag) {
+        case ATOM_H1:
+            style->color = VGA_COLOR_LIGHT_CYAN;
+            style->bold = true;
+            style->is_block = true;
+            style->margin_top = 1;
+            style->margin_bottom = 1;
+            break;
+        case ATOM_H2:
+            style->color = VGA_COLOR_LIGHT_GREEN;
+            style->bold = true;
+            style->is_block = true;
+            style->margin_top = 1;
+            style->margin_bottom = 1;
+            break;
+        case ATOM_H3:
+            style->color = VGA_COLOR_LIGHT_BROWN;
+            style->bold = true;
+            style->is_block = true;
+            break;
+        case ATOM_H4:
+        case ATOM_H5:
+        case ATOM_H6:
+            style->color = VGA_COLOR_WHITE;
+            style->bold = true;
+            style->is_block = true;
+            break;
+        case ATOM_P:
+            style->is_block = true;
+            style->margin_bottom = 1;
+            break;
+        case ATOM_DIV:
+            style->is_block = true;
+            break;
+        case ATOM_SPAN:
+            style->is_block = false;
+            break;
+        case ATOM_A:
+            style->color = VGA_COLOR_LIGHT_MAGENTA;
+            style->underline = true;
+            break;
+        case ATOM_STRONG:
+        case ATOM_B:
+            style->bold = true;
+            style->color = VGA_COLOR_WHITE;
+            break;
+        case ATOM_EM:
+        case ATOM_I:
+            style->italic = true;
+            break;
+        case ATOM_U:
+            style->underline = true;
+            break;
+        case ATOM_CODE:
+        case ATOM_PRE:
+            style->color = VGA_COLOR_LIGHT_GREEN;
+            style->background_color = VGA_COLOR_DARK_GREY;
+            break;
+        case ATOM_BLOCKQUOTE:
+            style->color = VGA_COLOR_CYAN;
+            style->is_block = true;
+            style->margin_left = 4;
+            break;
+        case ATOM_UL:
+        case ATOM_OL:
+            style->is_block = true;
+            style->margin_left = 2;
+            break;
+        case ATOM_LI:
+            style->is_block = true;
+            style->color = VGA_COLOR_CYAN;
+            break;
+        case ATOM_HR:
+            style->is_block = true;
+            style->color = VGA_COLOR_DARK_GREY;
+            break;
+        case ATOM_BUTTON:
+            style->color = VGA_COLOR_BLACK;
+            style->background_color = VGA_COLOR_LIGHT_GREY;
+            break;
+        case ATOM_INPUT:
+            style->color = VGA_COLOR_WHITE;
+            style->background_color = VGA_COLOR_BLUE;
+            break;
+        default:
+            break;
     }
 }
 
@@ -326,6 +333,7 @@ bool css_parse_inline(const char* style_attr, css_computed_style_t* style) {
             
             // Apply property
             css_property_type_t type = css_parse_property_name(prop_name);
+            atom_t keyword = atom_find(prop_value);
             
             switch (type) {
                 case CSS_PROP_COLOR:
@@ -335,27 +343,24 @@ bool css_parse_inline(const char* style_attr, css_computed_style_t* style) {
                     style->background_color = css_color_to_vga(prop_value);
                     break;
                 case CSS_PROP_FONT_WEIGHT:
-                    style->bold = (strcmp(prop_value, "bold") == 0 || 
-                                  strcmp(prop_value, "700") == 0 ||
-                                  strcmp(prop_value, "800") == 0 ||
-                                  strcmp(prop_value, "900") == 0);
+                    style->bold = (keyword == ATOM_BOLD || keyword == ATOM_700 ||
+                                   keyword == ATOM_800 || keyword == ATOM_900);
                     break;
                 case CSS_PROP_FONT_STYLE:
-                    style->italic = (strcmp(prop_value, "italic") == 0 ||
-                                   strcmp(prop_value, "oblique") == 0);
+                    style->italic = (keyword == ATOM_ITALIC || keyword == ATOM_OBLIQUE);
                     break;
                 case CSS_PROP_TEXT_DECORATION:
-                    style->underline = (css_strstr(prop_value, "underline") != NULL);
+                    style->underline = (strstr(prop_value, "underline") != NULL);
                     break;
                 case CSS_PROP_TEXT_ALIGN:
-                    if (strcmp(prop_value, "center") == 0) style->text_align = 1;
-                    else if (strcmp(prop_value, "right") == 0) style->text_align = 2;
+                    if (keyword == ATOM_CENTER) style->text_align = 1;
+                    else if (keyword == ATOM_RIGHT) style->text_align = 2;
                     else style->text_align = 0;
                     break;
                 case CSS_PROP_DISPLAY:
-                    if (strcmp(prop_value, "none") == 0) style->is_hidden = true;
-                    else if (strcmp(prop_value, "block") == 0) style->is_block = true;
-                    else if (strcmp(prop_value, "inline") == 0) style->is_block = false;
+                    if (keyword == ATOM_NONE_KEYWORD) style->is_hidden = true;
+                    else if (keyword == ATOM_BLOCK) style->is_block = true;
+                    else if (keyword == ATOM_INLINE) style->is_block = false;
                     break;
                 default:
                     break;
@@ -368,18 +373,6 @@ bool css_parse_inline(const char* style_attr, css_computed_style_t* style) {
     return true;
 }
 
-// Simple strstr implementation
-static const char* css_strstr(const char* haystack, const char* needle) {
-    if (!*needle) return haystack;
-    for (; *haystack; haystack++) {
-        const char* h = haystack;
-        const char* n = needle;
-        while (*h && *n && *h == *n) { h++; n++; }
-        if (!*n) return haystack;
-    }
-    return NULL;
-}
-
 bool css_parse(const char* css_text, css_stylesheet_t* stylesheet) {
     if (!css_text || !stylesheet) return false;
     
@@ -398,21 +391,30 @@ bool css_parse(const char* css_text, css_stylesheet_t* stylesheet) {
         }
         
         // Parse selector
-        css_rule_t* rule = &stylesheet->rules[stylesheet->rule_count];
+        css_rule_t* rule = (css_rule_t*)arena_alloc(stylesheet->arena, sizeof(css_rule_t));
+        if (!rule) break;
+        stylesheet->rules[stylesheet->rule_count] = rule;
+        char selector[CSS_MAX_SELECTOR_LEN];
         int i = 0;
         while (*p && *p != '{' && i < CSS_MAX_SELECTOR_LEN - 1) {
             if (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') {
-                if (i > 0 && rule->selector[i-1] != ' ') {
-                    rule->selector[i++] = ' ';
+                if (i > 0 && selector[i-1] != ' ') {
+                    selector[i++] = ' ';
                 }
             } else {
-                rule->selector[i++] = *p;
+                selector[i++] = *p;
             }
             p++;
         }
         // Trim trailing space
-        while (i > 0 && rule->selector[i-1] == ' ') i--;
-        rule->selector[i] = '\0';
+        while (i > 0 && selector[i-1] == ' ') i--;
+        selector[i] = '\0';
+        
+        // Matching compares atoms, so intern the name once here
+        rule->selector_kind = CSS_SELECT_TAG;
+        if (selector[0] == '#') rule->selector_kind = CSS_SELECT_ID;
+        if (selector[0] == '.') rule->selector_kind = CSS_SELECT_CLASS;
+        rule->selector = atom_intern(selector + (rule->selector_kind == CSS_SELECT_TAG ? 0 : 1));
         
         if (*p == '{') {
             p++;
@@ -450,6 +452,7 @@ bool css_parse(const char* css_text, css_stylesheet_t* stylesheet) {
                     // Trim trailing whitespace
                     while (i > 0 && (prop->value[i-1] == ' ' || prop->value[i-1] == '\n')) i--;
                     prop->value[i] = '\0';
+                    prop->keyword = atom_find(prop->value);
                     
                     rule->property_count++;
                 }
@@ -465,31 +468,22 @@ bool css_parse(const char* css_text, css_stylesheet_t* stylesheet) {
     return true;
 }
 
-void css_compute_style(const char* tag_name, const char* class_name,
-                       const char* id, const char* inline_style,
+void css_compute_style(atom_t tag, atom_t class_name, atom_t id,
+                       const char* inline_style,
                        const css_stylesheet_t* stylesheet,
                        css_computed_style_t* out_style) {
     // Get default style
-    css_get_default_style(tag_name, out_style);
+    css_get_default_style(tag, out_style);
     
     // Apply stylesheet rules
     if (stylesheet) {
         for (int r = 0; r < stylesheet->rule_count; r++) {
-            const css_rule_t* rule = &stylesheet->rules[r];
-            bool matches = false;
+            const css_rule_t* rule = stylesheet->rules[r];
+            atom_t name = (rule->selector_kind == CSS_SELECT_ID) ? id :
+                          (rule->selector_kind == CSS_SELECT_CLASS) ? class_name : tag;
             
             // Check if selector matches
-            if (rule->selector[0] == '#' && id) {
-                matches = (strcmp(rule->selector + 1, id) == 0);
-            }
-            else if (rule->selector[0] == '.') {
-                matches = (class_name && strcmp(rule->selector + 1, class_name) == 0);
-            }
-            else {
-                matches = (tag_name && strcmp(rule->selector, tag_name) == 0);
-            }
-            
-            if (matches) {
+            if (rule->selector != ATOM_NONE && rule->selector == name) {
                 // Apply properties
                 for (int p = 0; p < rule->property_count; p++) {
                     const css_property_t* prop = &rule->properties[p];
@@ -502,11 +496,11 @@ void css_compute_style(const char* tag_name, const char* class_name,
                             out_style->background_color = css_color_to_vga(prop->value);
                             break;
                         case CSS_PROP_FONT_WEIGHT:
-                            out_style->bold = (strcmp(prop->value, "bold") == 0);
+                            out_style->bold = (prop->keyword == ATOM_BOLD);
                             break;
                         case CSS_PROP_TEXT_ALIGN:
-                            if (strcmp(prop->value, "center") == 0) out_style->text_align = 1;
-                            else if (strcmp(prop->value, "right") == 0) out_style->text_align = 2;
+                            if (prop->keyword == ATOM_CENTER) out_style->text_align = 1;
+                            else if (prop->keyword == ATOM_RIGHT) out_style->text_align = 2;
                             break;
                         default:
                             break;
@@ -534,3 +528,9 @@ void css_reset_stylesheet(css_stylesheet_t* stylesheet) {
         stylesheet->rule_count = 0;
     }
 }
+
+void css_set_arena(css_stylesheet_t* stylesheet, arena_t* arena) {
+    if (stylesheet) {
+        stylesheet->arena = arena;
+    }
+}
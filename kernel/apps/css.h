@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../vga.h"
+#include "../memory.h"
+#include "../atom.h"
 
 // Maximum CSS rules and properties
 #define CSS_MAX_RULES 64
@@ -37,21 +39,32 @@ typedef enum {
 // CSS property value
 typedef struct {
     css_property_type_t type;
+    atom_t keyword;           // Value as a known atom, or ATOM_NONE
     char value[CSS_MAX_VALUE_LEN];
     int numeric_value;
 } css_property_t;
 
+// What a selector matches on
+typedef enum {
+    CSS_SELECT_TAG,
+    CSS_SELECT_CLASS,         // .name
+    CSS_SELECT_ID             // #name
+} css_selector_kind_t;
+
 // CSS rule (selector + properties)
 typedef struct {
-    char selector[CSS_MAX_SELECTOR_LEN];
+    css_selector_kind_t selector_kind;
+    atom_t selector;          // Name without the '.' or '#'
     css_property_t properties[CSS_MAX_PROPERTIES];
     int property_count;
 } css_rule_t;
 
-// CSS stylesheet
+// CSS stylesheet; rules are allocated from the owner's arena and live
+// until the arena is reset
 typedef struct {
-    css_rule_t rules[CSS_MAX_RULES];
+    css_rule_t* rules[CSS_MAX_RULES];
     int rule_count;
+    arena_t* arena;
 } css_stylesheet_t;
 
 // Computed style for an element
@@ -79,9 +92,9 @@ bool css_parse(const char* css_text, css_stylesheet_t* stylesheet);
 // Parse inline style attribute
 bool css_parse_inline(const char* style_attr, css_computed_style_t* style);
 
-// Get computed style for an element
-void css_compute_style(const char* tag_name, const char* class_name, 
-                       const char* id, const char* inline_style,
+// Get computed style for an element; ATOM_NONE for a missing name
+void css_compute_style(atom_t tag, atom_t class_name, atom_t id,
+                       const char* inline_style,
                        const css_stylesheet_t* stylesheet,
                        css_computed_style_t* out_style);
 
@@ -89,7 +102,7 @@ void css_compute_style(const char* tag_name, const char* class_name,
 uint8_t css_color_to_vga(const char* color);
 
 // Get default style for a tag
-void css_get_default_style(const char* tag_name, css_computed_style_t* style);
+void css_get_default_style(atom_t tag, css_computed_style_t* style);
 
 // Apply style to VGA
 void css_apply_style(const css_computed_style_t* style);
@@ -97,7 +110,10 @@ void css_apply_style(const css_computed_style_t* style);
 // Parse a single CSS property
 css_property_type_t css_parse_property_name(const char* name);
 
-// Reset stylesheet
+// Reset stylesheet (the caller resets the arena the rules came from)
 void css_reset_stylesheet(css_stylesheet_t* stylesheet);
 
+// Set the arena new rules are allocated from
+void css_set_arena(css_stylesheet_t* stylesheet, arena_t* arena);
+
 #endif // CSS_H
@@ -212,33 +212,48 @@ void js_set_dom_callbacks(js_context_t* ctx,
     ctx->set_element_callback = set_cb;
 }
 
+void js_set_arena(js_context_t* ctx, arena_t* arena) {
+    ctx->arena = arena;
+}
+
 void js_set_audio_callback(js_context_t* ctx, js_play_audio_callback_t callback) {
     ctx->play_audio_callback = callback;
 }
 
 js_value_t* js_get_variable(js_context_t* ctx, const char* name) {
+    // A name that was never interned can't belong to a variable
+    atom_t atom = atom_find(name);
+    if (atom == ATOM_NONE) return NULL;
+    
     for (int i = 0; i < ctx->variable_count; i++) {
-        if (strcmp(ctx->variables[i].name, name) == 0) {
-            return &ctx->variables[i].value;
+        if (ctx->variables[i]->name == atom) {
+            return &ctx->variables[i]->value;
         }
     }
     return NULL;
 }
 
 void js_set_variable(js_context_t* ctx, const char* name, js_value_t value) {
+    atom_t atom = atom_intern(name);
+    if (atom == ATOM_NONE) return;
+    
     // Check if variable exists
     for (int i = 0; i < ctx->variable_count; i++) {
-        if (strcmp(ctx->variables[i].name, name) == 0) {
-            ctx->variables[i].value = value;
+        if (ctx->variables[i]->name == atom) {
+            ctx->variables[i]->value = value;
             return;
         }
     }
     
     // Add new variable
+    js_variable_t* var = NULL;
     if (ctx->variable_count < JS_MAX_VARIABLES) {
-        strncpy(ctx->variables[ctx->variable_count].name, name, 63);
-        ctx->variables[ctx->variable_count].value = value;
-        ctx->variable_count++;
+        var = (js_variable_t*)arena_calloc(ctx->arena, sizeof(js_variable_t));
+    }
+    if (var) {
+        var->name = atom;
+        var->value = value;
+        ctx->variables[ctx->variable_count++] = var;
     }
 }
 
@@ -263,50 +278,53 @@ static void set_error(js_context_t* ctx, const char* msg) {
 
 // Call a function
 static js_value_t call_function(js_context_t* ctx, const char* name, const char** args, int arg_count) {
+    atom_t atom = atom_find(name);
+    if (atom == ATOM_NONE) return js_undefined();
+    
     // Built-in functions
-    if (strcmp(name, "alert") == 0) {
+    if (atom == ATOM_ALERT) {
         if (arg_count > 0 && ctx->alert_callback) {
             ctx->alert_callback(args[0]);
         }
         return js_undefined();
     }
     
-    if (strcmp(name, "console.log") == 0 || strcmp(name, "log") == 0) {
+    if (atom == ATOM_CONSOLE_LOG || atom == ATOM_LOG) {
         if (arg_count > 0 && ctx->console_callback) {
             ctx->console_callback(args[0]);
         }
         return js_undefined();
     }
     
-    if (strcmp(name, "parseInt") == 0) {
+    if (atom == ATOM_PARSE_INT) {
         if (arg_count > 0) {
             return js_number(atoi(args[0]));
         }
         return js_number(0);
     }
     
-    if (strcmp(name, "String") == 0) {
+    if (atom == ATOM_STRING) {
         if (arg_count > 0) {
             return js_string(args[0]);
         }
         return js_string("");
     }
     
-    if (strcmp(name, "Math.floor") == 0) {
+    if (atom == ATOM_MATH_FLOOR) {
         if (arg_count > 0) {
             return js_number((int)atoi(args[0]));
         }
         return js_number(0);
     }
     
-    if (strcmp(name, "Math.random") == 0) {
+    if (atom == ATOM_MATH_RANDOM) {
         // Simple pseudo-random (not great, but works)
         static uint32_t seed = 12345;
         seed = seed * 1103515245 + 12345;
         return js_number((double)(seed % 1000) / 1000.0);
     }
     
-    if (strcmp(name, "playAudio") == 0 || strcmp(name, "play") == 0) {
+    if (atom == ATOM_PLAY_AUDIO || atom == ATOM_PLAY) {
         if (arg_count > 0 && ctx->play_audio_callback) {
             ctx->play_audio_callback(args[0]);
         }
@@ -315,7 +333,7 @@ static js_value_t call_function(js_context_t* ctx, const char* name, const char*
     
     // Look for user-defined function
     for (int i = 0; i < ctx->function_count; i++) {
-        if (strcmp(ctx->functions[i].name, name) == 0) {
+        if (ctx->functions[i]->name == atom) {
             if (ctx->call_depth >= JS_MAX_CALL_STACK) {
                 set_error(ctx, "Maximum call stack exceeded");
                 return js_undefined();
@@ -324,7 +342,7 @@ static js_value_t call_function(js_context_t* ctx, const char* name, const char*
             ctx->call_depth++;
             
             // User-defined functions currently ignore parameter lists and just run the stored body
-            const char* body = ctx->functions[i].body;
+            const char* body = ctx->functions[i]->body;
             js_value_t result = js_execute(ctx, body);
             
             ctx->call_depth--;
@@ -676,12 +694,23 @@ static js_value_t eval_statement(js_context_t* ctx, const char** code) {
             body[bi] = '\0';
         }
         
-        // Store function
-        if (ctx->function_count < JS_MAX_FUNCTIONS) {
-            strncpy(ctx->functions[ctx->function_count].name, name, 63);
-            strncpy(ctx->functions[ctx->function_count].params, params, 127);
-            strncpy(ctx->functions[ctx->function_count].body, body, 511);
-            ctx->function_count++;
+        // Store function; redeclaring a name replaces the old body
+        atom_t atom = atom_intern(name);
+        js_function_t* fn = NULL;
+        for (int i = 0; atom != ATOM_NONE && i < ctx->function_count; i++) {
+            if (ctx->functions[i]->name == atom) {
+                fn = ctx->functions[i];
+                break;
+            }
+        }
+        if (!fn && atom != ATOM_NONE && ctx->function_count < JS_MAX_FUNCTIONS) {
+            fn = (js_function_t*)arena_calloc(ctx->arena, sizeof(js_function_t));
+            if (fn) ctx->functions[ctx->function_count++] = fn;
+        }
+        if (fn) {
+            fn->name = atom;
+            strncpy(fn->params, params, 127);
+            strncpy(fn->body, body, 511);
         }
         
         return js_undefined();
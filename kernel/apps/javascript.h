@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "../memory.h"
+#include "../atom.h"
 
 // JS engine limits
 #define JS_MAX_VARIABLES 64
@@ -43,22 +45,22 @@ typedef struct js_value {
 
 // Variable in scope
 typedef struct {
-    char name[64];
+    atom_t name;
     js_value_t value;
 } js_variable_t;
 
 // Function definition
 typedef struct {
-    char name[64];
+    atom_t name;
     char params[128];  // Comma-separated parameter names
     char body[512];    // Function body code
 } js_function_t;
 
 // DOM element (simplified)
 typedef struct {
-    char tag[32];
-    char id[64];
-    char class_name[64];
+    atom_t tag;
+    atom_t id;
+    atom_t class_name;
     char inner_text[256];
     char style[256];
     bool visible;
@@ -71,14 +73,17 @@ typedef js_dom_element_t* (*js_get_element_callback_t)(const char* id);
 typedef void (*js_set_element_callback_t)(const char* id, const char* property, const char* value);
 typedef void (*js_play_audio_callback_t)(const char* src);
 
-// JavaScript execution context
+// JavaScript execution context. Variables and functions are allocated
+// from the owner's arena and live until the arena is reset.
 typedef struct js_context {
-    js_variable_t variables[JS_MAX_VARIABLES];
+    js_variable_t* variables[JS_MAX_VARIABLES];
     int variable_count;
     
-    js_function_t functions[JS_MAX_FUNCTIONS];
+    js_function_t* functions[JS_MAX_FUNCTIONS];
     int function_count;
     
+    arena_t* arena;
+    
     // Callbacks for browser integration
     js_alert_callback_t alert_callback;
     js_console_callback_t console_callback;
@@ -105,6 +110,9 @@ void js_set_dom_callbacks(js_context_t* ctx,
                           js_set_element_callback_t set_cb);
 void js_set_audio_callback(js_context_t* ctx, js_play_audio_callback_t callback);
 
+// Set the arena variables and functions are allocated from
+void js_set_arena(js_context_t* ctx, arena_t* arena);
+
 // Execute JavaScript code
 js_value_t js_execute(js_context_t* ctx, const char* code);
 
@@ -132,7 +140,7 @@ bool js_has_error(const js_context_t* ctx);
 const char* js_get_error(const js_context_t* ctx);
 void js_clear_error(js_context_t* ctx);
 
-// Reset context
+// Reset context (the caller resets the arena)
 void js_reset(js_context_t* ctx);
 
 #endif // JAVASCRIPT_H
@@ -7,9 +7,14 @@
 
 // Lightweight text editor that keeps everything in memory and draws directly to VGA.
 
-// In-memory document the user is editing
-static char document[NOTEPAD_MAX_SIZE];
+// In-memory document the user is editing. It is movable heap memory
+// that grows as text is typed; document only points at it while the
+// editor runs, so the heap can be compacted around it otherwise.
+#define NOTEPAD_INITIAL_SIZE 4096
+static handle_t document_handle = 0;
+static char* document = NULL;
 static int doc_length = 0;
+static int doc_capacity = 0;
 
 // Line starts to make cursor math fast
 static int line_starts[NOTEPAD_MAX_LINES];
@@ -186,7 +191,7 @@ static void draw_content(void) {
             vga_putchar_at(' ', x, y);
         }
         
-        if (line < line_count) {
+        if (document && line < line_count) {
             int line_start = line_starts[line];
             int line_len = get_line_length(line);
             
@@ -225,12 +230,41 @@ static void update_hw_cursor(void) {
     vga_update_cursor(hw_x, hw_y);
 }
 
+// Double the document buffer, up to NOTEPAD_MAX_SIZE
+static bool grow_document(void) {
+    int new_capacity = doc_capacity * 2;
+    if (new_capacity > NOTEPAD_MAX_SIZE) new_capacity = NOTEPAD_MAX_SIZE;
+    if (new_capacity <= doc_capacity) return false;
+    
+    // The buffer can only move while unlocked
+    hunlock(document_handle);
+    bool grown = hrealloc(document_handle, new_capacity);
+    document = (char*)hlock(document_handle);
+    
+    if (grown) {
+        doc_capacity = new_capacity;
+    }
+    return grown;
+}
+
 void notepad_init(void) {
+    if (document_handle == 0) {
+        document_handle = hmalloc(NOTEPAD_INITIAL_SIZE);
+        doc_capacity = document_handle ? NOTEPAD_INITIAL_SIZE : 0;
+        doc_length = 0;
+    }
+    
+    document = (char*)hlock(document_handle);
     notepad_clear();
+    hunlock(document_handle);
+    document = NULL;
 }
 
 void notepad_clear(void) {
-    memset(document, 0, NOTEPAD_MAX_SIZE);
+    if (document == NULL) return;
+    
+    // Only the used part has ever been touched
+    memset(document, 0, doc_length + 1);
     doc_length = 0;
     cursor_pos = 0;
     cursor_x = 0;
@@ -254,7 +288,8 @@ void notepad_redraw(void) {
 }
 
 void notepad_insert_char(char c) {
-    if (doc_length >= NOTEPAD_MAX_SIZE - 1) return;
+    if (document == NULL) return;
+    if (doc_length >= doc_capacity - 1 && !grow_document()) return;
     
     // Shift text after cursor
     for (int i = doc_length; i > cursor_pos; i--) {
@@ -263,6 +298,7 @@ void notepad_insert_char(char c) {
     
     document[cursor_pos] = c;
     doc_length++;
+    document[doc_length] = '\0';
     cursor_pos++;
     
     recalc_lines();
@@ -270,7 +306,7 @@ void notepad_insert_char(char c) {
 }
 
 void notepad_delete_char(void) {
-    if (cursor_pos >= doc_length) return;
+    if (document == NULL || cursor_pos >= doc_length) return;
     
     // Shift text after cursor
     for (int i = cursor_pos; i < doc_length - 1; i++) {
@@ -337,7 +373,7 @@ int notepad_get_cursor_y(void) {
 }
 
 const char* notepad_get_content(void) {
-    return document;
+    return document ? document : "";
 }
 
 int notepad_get_line_count(void) {
@@ -345,6 +381,9 @@ int notepad_get_line_count(void) {
 }
 
 void notepad_run(void) {
+    document = (char*)hlock(document_handle);
+    if (document == NULL) return;  // Out of memory
+    
     vga_clear();
     notepad_redraw();
     
@@ -428,4 +467,7 @@ void notepad_run(void) {
         
         notepad_redraw();
     }
+    
+    hunlock(document_handle);
+    document = NULL;
 }
@@ -40,7 +40,7 @@ void notepad_set_cursor(int x, int y);
 int notepad_get_cursor_x(void);
 int notepad_get_cursor_y(void);
 
-// Get document content
+// Get document content (empty unless the editor is running)
 const char* notepad_get_content(void);
 
 // Get current line count
@@ -6,6 +6,11 @@
 #include "../disk.h"
 #include "../network.h"
 #include "../audio.h"
+#include "../ktimer.h"
+#include "../io.h"
+
+// Time between automatic refreshes
+#define SYSMON_REFRESH_MS 1000
 
 // Refresh counter for simulation
 static int refresh_counter = 0;
@@ -14,6 +19,18 @@ static int refresh_counter = 0;
 static int cpu_history[40];
 static int history_index = 0;
 
+// Heap profile page instead of the overview
+static bool show_profile = false;
+
+// Set by refresh_timer each SYSMON_REFRESH_MS
+static ktimer_t refresh_timer;
+static volatile bool refresh_due = false;
+
+static void refresh_tick(void* data) {
+    (void)data;
+    refresh_due = true;
+}
+
 // Simple pseudo-random for simulation
 static uint32_t sysmon_rand_seed = 54321;
 static int sysmon_rand(void) {
@@ -47,7 +64,9 @@ static void draw_statusbar(void) {
         vga_putchar_at(' ', x, VGA_HEIGHT - 1);
     }
     
-    const char* status = " R: Refresh | ESC: Exit | Auto-refresh active";
+    const char* status = show_profile ?
+        " R: Refresh | P: Overview | O: Profiling on/off | ESC: Exit" :
+        " R: Refresh | P: Heap profile | ESC: Exit | Auto-refresh active";
     for (int i = 0; status[i] && i < VGA_WIDTH - 1; i++) {
         vga_putchar_at(status[i], i, VGA_HEIGHT - 1);
     }
@@ -209,6 +228,61 @@ static void draw_memory_panel(void) {
     vga_puts_at(mem_str, x + 10, y + 8);
 }
 
+// Print a number so that its last digit lands just left of right_x
+static void put_number_right(uint32_t value, int right_x, int y) {
+    char buf[12];
+    utoa(value, buf, 10);
+    vga_puts_at(buf, right_x - strlen(buf), y);
+}
+
+static void draw_profile_panel(void) {
+    int x = 1, y = 2, w = 78, h = 21;
+    draw_box(x, y, w, h, "Heap Profile");
+    
+    vga_set_color(vga_entry_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK));
+    vga_puts_at("Profiling:", x + 2, y + 1);
+    if (memory_profile_enabled()) {
+        vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+        vga_puts_at("On", x + 13, y + 1);
+    } else {
+        vga_set_color(vga_entry_color(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
+        vga_puts_at("Off", x + 13, y + 1);
+    }
+    
+    memprof_site_t sites[16];
+    int count = memory_profile_top(sites, 16);
+    if (count == 0) {
+        vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        vga_puts_at("No allocation sites recorded yet.", x + 2, y + 3);
+        return;
+    }
+    
+    vga_set_color(vga_entry_color(VGA_COLOR_CYAN, VGA_COLOR_BLACK));
+    vga_puts_at("Call site", x + 2, y + 2);
+    vga_puts_at("Live bytes", x + 15, y + 2);
+    vga_puts_at("Blocks", x + 28, y + 2);
+    vga_puts_at("Peak bytes", x + 37, y + 2);
+    vga_puts_at("Allocs", x + 50, y + 2);
+    vga_puts_at("Share", x + 59, y + 2);
+    
+    // Share of the used heap, in KB so the bar math can't overflow
+    int used_kb = (int)(memory_get_used() / 1024) + 1;
+    for (int i = 0; i < count; i++) {
+        int row = y + 3 + i;
+        char addr[12] = "0x";
+        utoa((uint32_t)sites[i].caller, addr + 2, 16);
+        
+        vga_set_color(vga_entry_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+        vga_puts_at(addr, x + 2, row);
+        put_number_right((uint32_t)sites[i].live_bytes, x + 25, row);
+        put_number_right(sites[i].live_count, x + 34, row);
+        put_number_right((uint32_t)sites[i].peak_bytes, x + 47, row);
+        put_number_right(sites[i].alloc_count, x + 56, row);
+        draw_progress_bar(x + 59, row, 16, (int)(sites[i].live_bytes / 1024), used_kb,
+                          VGA_COLOR_BROWN);
+    }
+}
+
 static void draw_disk_panel(void) {
     int x = 1, y = 12, w = 39, h = 6;
     draw_box(x, y, w, h, "Storage");
@@ -348,11 +422,15 @@ void sysmon_init(void) {
 void sysmon_redraw(void) {
     vga_clear();
     draw_titlebar();
-    draw_cpu_panel();
-    draw_memory_panel();
-    draw_disk_panel();
-    draw_network_panel();
-    draw_audio_panel();
+    if (show_profile) {
+        draw_profile_panel();
+    } else {
+        draw_cpu_panel();
+        draw_memory_panel();
+        draw_disk_panel();
+        draw_network_panel();
+        draw_audio_panel();
+    }
     draw_statusbar();
 }
 
@@ -361,7 +439,9 @@ void sysmon_run(void) {
     sysmon_redraw();
     
     bool running = true;
-    int auto_refresh = 0;
+    refresh_due = false;
+    ktimer_init(&refresh_timer, refresh_tick, NULL);
+    ktimer_start_periodic(&refresh_timer, SYSMON_REFRESH_MS);
     
     while (running) {
         // Check for key without blocking
@@ -377,15 +457,20 @@ void sysmon_run(void) {
                 default:
                     if (event.ascii == 'r' || event.ascii == 'R') {
                         sysmon_redraw();
+                    } else if (event.ascii == 'p' || event.ascii == 'P') {
+                        show_profile = !show_profile;
+                        sysmon_redraw();
+                    } else if (show_profile && (event.ascii == 'o' || event.ascii == 'O')) {
+                        memory_profile_enable(!memory_profile_enabled());
+                        sysmon_redraw();
                     }
                     break;
             }
         }
         
-        // Auto-refresh simulation (crude timing)
-        auto_refresh++;
-        if (auto_refresh > 50000) {
-            auto_refresh = 0;
+        // Auto-refresh
+        if (refresh_due) {
+            refresh_due = false;
             
             // Simulate network activity
             network_simulate_activity();
@@ -393,5 +478,10 @@ void sysmon_run(void) {
             // Redraw
             sysmon_redraw();
         }
+        
+        // Sleep until the next tick or key
+        hlt();
     }
+    
+    ktimer_cancel(&refresh_timer);
 }
@@ -0,0 +1,155 @@
+#include "atom.h"
+#include "memory.h"
+#include "string.h"
+
+// Hash table size at boot (a power of two) and the arena chunk size the
+// strings are packed into
+#define ATOM_INITIAL_SLOTS 256
+#define ATOM_STRING_CHUNK  4096
+
+// One interned string; the hash is kept so growing the table doesn't
+// have to rehash the text
+typedef struct {
+    const char* name;
+    uint32_t len;
+    uint32_t hash;
+} atom_entry_t;
+
+// Entries indexed by atom, and an open-addressed table of atoms (0 marks
+// an empty slot, which is why ATOM_NONE is never stored in it)
+static atom_entry_t* entries = NULL;
+static uint32_t entry_count = 0;
+static uint32_t entry_capacity = 0;
+static atom_t* slots = NULL;
+static uint32_t slot_count = 0;
+
+static arena_t* strings = NULL;
+static size_t string_bytes = 0;
+
+static const char* const static_names[] = {
+#define ATOM_NAME(id, str) str,
+    ATOM_STATIC_LIST(ATOM_NAME)
+#undef ATOM_NAME
+};
+
+// FNV-1a
+static uint32_t hash_bytes(const char* str, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Slot holding the atom for str, or the empty slot where it would go
+static atom_t* find_slot(const char* str, size_t len, uint32_t hash) {
+    uint32_t mask = slot_count - 1;
+    uint32_t i = hash & mask;
+
+    while (slots[i] != ATOM_NONE) {
+        const atom_entry_t* e = &entries[slots[i]];
+        if (e->hash == hash && e->len == len && memcmp(e->name, str, len) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &slots[i];
+}
+
+// Double the hash table, keeping it at most three-quarters full
+static bool grow_slots(void) {
+    uint32_t new_count = slot_count * 2;
+    atom_t* new_slots = (atom_t*)kcalloc(new_count, sizeof(atom_t));
+    if (new_slots == NULL) return false;
+
+    for (atom_t atom = 1; atom < entry_count; atom++) {
+        uint32_t i = entries[atom].hash & (new_count - 1);
+        while (new_slots[i] != ATOM_NONE) {
+            i = (i + 1) & (new_count - 1);
+        }
+        new_slots[i] = atom;
+    }
+
+    kfree(slots);
+    slots = new_slots;
+    slot_count = new_count;
+    return true;
+}
+
+bool atom_init(void) {
+    strings = arena_create(ATOM_STRING_CHUNK);
+    slots = (atom_t*)kcalloc(ATOM_INITIAL_SLOTS, sizeof(atom_t));
+    entry_capacity = ATOM_INITIAL_SLOTS;
+    entries = (atom_entry_t*)kmalloc(entry_capacity * sizeof(atom_entry_t));
+    if (strings == NULL || slots == NULL || entries == NULL) return false;
+
+    slot_count = ATOM_INITIAL_SLOTS;
+    entries[ATOM_NONE].name = "";
+    entries[ATOM_NONE].len = 0;
+    entries[ATOM_NONE].hash = 0;
+    entry_count = 1;
+    string_bytes = 0;
+
+    // The static atoms must come out numbered as atom.h declares them
+    for (atom_t atom = 1; atom < ATOM_STATIC_COUNT; atom++) {
+        if (atom_intern(static_names[atom - 1]) != atom) return false;
+    }
+    return true;
+}
+
+atom_t atom_intern_len(const char* str, size_t len) {
+    if (slots == NULL || str == NULL || len == 0) return ATOM_NONE;
+
+    uint32_t hash = hash_bytes(str, len);
+    atom_t* slot = find_slot(str, len, hash);
+    if (*slot != ATOM_NONE) return *slot;
+
+    // New string: make room, then copy it into the arena
+    if ((entry_count + 1) * 4 > slot_count * 3) {
+        if (!grow_slots()) return ATOM_NONE;
+        slot = find_slot(str, len, hash);
+    }
+    if (entry_count == entry_capacity) {
+        atom_entry_t* grown = (atom_entry_t*)krealloc(entries, entry_capacity * 2 * sizeof(atom_entry_t));
+        if (grown == NULL) return ATOM_NONE;
+        entries = grown;
+        entry_capacity *= 2;
+    }
+    char* copy = (char*)arena_alloc(strings, len + 1);
+    if (copy == NULL) return ATOM_NONE;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    atom_t atom = entry_count++;
+    entries[atom].name = copy;
+    entries[atom].len = len;
+    entries[atom].hash = hash;
+    *slot = atom;
+    string_bytes += len + 1;
+    return atom;
+}
+
+atom_t atom_intern(const char* str) {
+    return str ? atom_intern_len(str, strlen(str)) : ATOM_NONE;
+}
+
+atom_t atom_find_len(const char* str, size_t len) {
+    if (slots == NULL || str == NULL || len == 0) return ATOM_NONE;
+    return *find_slot(str, len, hash_bytes(str, len));
+}
+
+atom_t atom_find(const char* str) {
+    return str ? atom_find_len(str, strlen(str)) : ATOM_NONE;
+}
+
+const char* atom_name(atom_t atom) {
+    return atom < entry_count ? entries[atom].name : "";
+}
+
+void atom_get_stats(atom_stats_t* stats) {
+    if (stats == NULL) return;
+
+    stats->count = entry_count;
+    stats->string_bytes = string_bytes;
+    stats->slots = slot_count;
+}
@@ -0,0 +1,116 @@
+#ifndef ATOM_H
+#define ATOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Interned strings. Each distinct string is stored once and named by a
+// small integer, so names compare with == instead of strcmp. Atoms are
+// never freed. ATOM_NONE stands for the empty string.
+
+typedef uint32_t atom_t;
+
+// Names atom_init interns first, in this order, so their atoms are
+// constants that can be switched on
+#define ATOM_STATIC_LIST(X) \
+    /* HTML tags */ \
+    X(ATOM_A, "a") \
+    X(ATOM_B, "b") \
+    X(ATOM_I, "i") \
+    X(ATOM_U, "u") \
+    X(ATOM_P, "p") \
+    X(ATOM_H1, "h1") \
+    X(ATOM_H2, "h2") \
+    X(ATOM_H3, "h3") \
+    X(ATOM_H4, "h4") \
+    X(ATOM_H5, "h5") \
+    X(ATOM_H6, "h6") \
+    X(ATOM_BR, "br") \
+    X(ATOM_HR, "hr") \
+    X(ATOM_EM, "em") \
+    X(ATOM_UL, "ul") \
+    X(ATOM_OL, "ol") \
+    X(ATOM_LI, "li") \
+    X(ATOM_DIV, "div") \
+    X(ATOM_PRE, "pre") \
+    X(ATOM_SPAN, "span") \
+    X(ATOM_CODE, "code") \
+    X(ATOM_STRONG, "strong") \
+    X(ATOM_BLOCKQUOTE, "blockquote") \
+    X(ATOM_BUTTON, "button") \
+    X(ATOM_INPUT, "input") \
+    /* CSS properties */ \
+    X(ATOM_COLOR, "color") \
+    X(ATOM_BACKGROUND, "background") \
+    X(ATOM_BACKGROUND_COLOR, "background-color") \
+    X(ATOM_FONT_WEIGHT, "font-weight") \
+    X(ATOM_FONT_STYLE, "font-style") \
+    X(ATOM_TEXT_DECORATION, "text-decoration") \
+    X(ATOM_TEXT_ALIGN, "text-align") \
+    X(ATOM_DISPLAY, "display") \
+    X(ATOM_MARGIN, "margin") \
+    X(ATOM_PADDING, "padding") \
+    X(ATOM_BORDER, "border") \
+    X(ATOM_WIDTH, "width") \
+    X(ATOM_HEIGHT, "height") \
+    /* CSS keywords */ \
+    X(ATOM_BOLD, "bold") \
+    X(ATOM_700, "700") \
+    X(ATOM_800, "800") \
+    X(ATOM_900, "900") \
+    X(ATOM_ITALIC, "italic") \
+    X(ATOM_OBLIQUE, "oblique") \
+    X(ATOM_CENTER, "center") \
+    X(ATOM_RIGHT, "right") \
+    X(ATOM_NONE_KEYWORD, "none") \
+    X(ATOM_BLOCK, "block") \
+    X(ATOM_INLINE, "inline") \
+    /* JavaScript built-ins */ \
+    X(ATOM_ALERT, "alert") \
+    X(ATOM_CONSOLE_LOG, "console.log") \
+    X(ATOM_LOG, "log") \
+    X(ATOM_PARSE_INT, "parseInt") \
+    X(ATOM_STRING, "String") \
+    X(ATOM_MATH_FLOOR, "Math.floor") \
+    X(ATOM_MATH_RANDOM, "Math.random") \
+    X(ATOM_PLAY_AUDIO, "playAudio") \
+    X(ATOM_PLAY, "play")
+
+typedef enum {
+    ATOM_NONE = 0,
+#define ATOM_ENUM(id, str) id,
+    ATOM_STATIC_LIST(ATOM_ENUM)
+#undef ATOM_ENUM
+    ATOM_STATIC_COUNT
+} atom_static_t;
+
+// Atom table statistics
+typedef struct {
+    size_t count;             // Atoms, including ATOM_NONE
+    size_t string_bytes;      // Bytes of interned text
+    size_t slots;             // Hash table size
+} atom_stats_t;
+
+// Create the table and intern the static atoms; call after memory_init
+bool atom_init(void);
+
+// Atom for a string, adding it if new; ATOM_NONE if out of memory
+atom_t atom_intern(const char* str);
+
+// Atom for the first len bytes of str, adding it if new
+atom_t atom_intern_len(const char* str, size_t len);
+
+// Atom for a string only if it was interned before, else ATOM_NONE
+atom_t atom_find(const char* str);
+
+// atom_find for the first len bytes of str
+atom_t atom_find_len(const char* str, size_t len);
+
+// Text of an atom ("" for ATOM_NONE or an unknown atom)
+const char* atom_name(atom_t atom);
+
+// Get table statistics
+void atom_get_stats(atom_stats_t* stats);
+
+#endif // ATOM_H
@@ -1,45 +1,68 @@
 #include "audio.h"
 #include "io.h"
-
-// PIT (Programmable Interval Timer) ports
-#define PIT_CHANNEL0    0x40
-#define PIT_CHANNEL1    0x41
-#define PIT_CHANNEL2    0x42
-#define PIT_COMMAND     0x43
+#include "ktimer.h"
+#include "timer.h"
 
 // PC Speaker port
 #define SPEAKER_PORT    0x61
 
-// PIT frequency
-#define PIT_FREQUENCY   1193180
+// Silence between the notes of a melody
+#define MELODY_GAP_MS   20
 
 // Audio state
 static bool audio_enabled = true;
 static uint8_t master_volume = 80;
 
-// Timer tick counter for delays
-static volatile uint32_t tick_count = 0;
+// Notes playing in the background, stepped on by sequence_timer
+static const note_t* sequence = NULL;
+static uint32_t sequence_gap_ms = 0;
+static bool sequence_in_gap = false;
+static ktimer_t sequence_timer;
+
+// Sound effects, with their pauses as rests
+static const note_t sfx_beep[] = { {800, 100}, {0, 0} };
+static const note_t sfx_click[] = { {1500, 20}, {0, 0} };
+static const note_t sfx_error[] = { {200, 150}, {0, 50}, {150, 200}, {0, 0} };
+static const note_t sfx_success[] = {
+    {NOTE_C5, 100}, {0, 30}, {NOTE_E5, 100}, {0, 30}, {NOTE_G5, 150}, {0, 0}
+};
+// Windows-like startup sound
+static const note_t sfx_startup[] = {
+    {NOTE_C5, 150}, {0, 30}, {NOTE_E5, 150}, {0, 30},
+    {NOTE_G5, 150}, {0, 30}, {NOTE_C6, 300}, {0, 0}
+};
+static const note_t sfx_shutdown[] = {
+    {NOTE_G5, 150}, {0, 50}, {NOTE_C5, 150}, {0, 50}, {NOTE_G4, 300}, {0, 0}
+};
+static const note_t sfx_notification[] = { {NOTE_A5, 100}, {0, 50}, {1109, 150}, {0, 0} };
+static const note_t sfx_keypress[] = { {2000, 10}, {0, 0} };
+
+static const note_t* const effects[] = {
+    [SFX_BEEP] = sfx_beep,
+    [SFX_CLICK] = sfx_click,
+    [SFX_ERROR] = sfx_error,
+    [SFX_SUCCESS] = sfx_success,
+    [SFX_STARTUP] = sfx_startup,
+    [SFX_SHUTDOWN] = sfx_shutdown,
+    [SFX_NOTIFICATION] = sfx_notification,
+    [SFX_KEYPRESS] = sfx_keypress,
+};
+
+static void sequence_step(void* data);
 
 void audio_init(void) {
     audio_enabled = true;
     master_volume = 80;
+    ktimer_init(&sequence_timer, sequence_step, NULL);
     audio_stop();
 }
 
-// Simple delay using busy wait (approximate)
 void audio_delay_ms(uint32_t ms) {
-    // Rough approximation - actual timing depends on CPU speed
-    // This uses a busy loop calibrated for ~1ms per iteration on typical systems
-    for (uint32_t i = 0; i < ms; i++) {
-        for (volatile uint32_t j = 0; j < 10000; j++) {
-            __asm__ volatile("nop");
-        }
-    }
+    ksleep_ms(ms);
 }
 
-void audio_play_tone(uint16_t frequency, uint16_t duration_ms) {
-    if (!audio_enabled || frequency == 0) return;
-    
+// Start the speaker sounding a frequency
+static void speaker_on(uint16_t frequency) {
     // Calculate PIT divisor
     uint32_t divisor = PIT_FREQUENCY / frequency;
     if (divisor > 65535) divisor = 65535;
@@ -55,13 +78,78 @@ void audio_play_tone(uint16_t frequency, uint16_t duration_ms) {
     // Enable speaker
     uint8_t speaker_state = inb(SPEAKER_PORT);
     outb(SPEAKER_PORT, speaker_state | 0x03);
-    
+}
+
+// How long a tone of duration_ms sounds at the current volume
+static uint16_t tone_length(uint16_t duration_ms) {
     // Adjust duration based on volume (lower volume = shorter duration for perceived quieter sound)
     uint16_t adjusted_duration = (duration_ms * master_volume) / 100;
     if (adjusted_duration < 10) adjusted_duration = 10;
+    return adjusted_duration;
+}
+
+// Sound the current note of the sequence and time it
+static void sequence_play_note(void) {
+    if (sequence->frequency == 0 && sequence->duration == 0) {
+        sequence = NULL;
+        return;
+    }
+    
+    sequence_in_gap = false;
+    if (sequence->frequency == 0) {
+        // Rest
+        ktimer_start(&sequence_timer, sequence->duration);
+    } else {
+        speaker_on(sequence->frequency);
+        ktimer_start(&sequence_timer, tone_length(sequence->duration));
+    }
+}
+
+// Timer callback: end the note, then after the gap (if any) start the next
+static void sequence_step(void* data) {
+    (void)data;
+    if (sequence == NULL) return;
+    
+    audio_stop();
+    if (!sequence_in_gap && sequence_gap_ms) {
+        sequence_in_gap = true;
+        ktimer_start(&sequence_timer, sequence_gap_ms);
+        return;
+    }
+    
+    sequence++;
+    sequence_play_note();
+}
+
+// Play notes in the background, gap_ms of silence after each one
+static void sequence_start(const note_t* notes, uint32_t gap_ms) {
+    audio_stop_sequence();
+    sequence = notes;
+    sequence_gap_ms = gap_ms;
+    sequence_play_note();
+}
+
+void audio_stop_sequence(void) {
+    ktimer_cancel(&sequence_timer);
+    if (sequence) {
+        sequence = NULL;
+        audio_stop();
+    }
+}
+
+bool audio_sequence_playing(void) {
+    return sequence != NULL;
+}
+
+void audio_play_tone(uint16_t frequency, uint16_t duration_ms) {
+    if (!audio_enabled || frequency == 0) return;
+    
+    // One speaker: a tone replaces whatever was sequencing
+    audio_stop_sequence();
+    speaker_on(frequency);
     
     // Wait for duration
-    audio_delay_ms(adjusted_duration);
+    audio_delay_ms(tone_length(duration_ms));
     
     // Stop tone
     audio_stop();
@@ -79,74 +167,21 @@ void audio_beep(void) {
 
 void audio_play_effect(sound_effect_t effect) {
     if (!audio_enabled) return;
+    if ((unsigned)effect >= sizeof(effects) / sizeof(effects[0])) return;
     
-    switch (effect) {
-        case SFX_BEEP:
-            audio_play_tone(800, 100);
-            break;
-            
-        case SFX_CLICK:
-            audio_play_tone(1500, 20);
-            break;
-            
-        case SFX_ERROR:
-            audio_play_tone(200, 150);
-            audio_delay_ms(50);
-            audio_play_tone(150, 200);
-            break;
-            
-        case SFX_SUCCESS:
-            audio_play_tone(523, 100);  // C5
-            audio_delay_ms(30);
-            audio_play_tone(659, 100);  // E5
-            audio_delay_ms(30);
-            audio_play_tone(784, 150);  // G5
-            break;
-            
-        case SFX_STARTUP: {
-            // Windows-like startup sound
-            audio_play_tone(523, 150);  // C5
-            audio_delay_ms(30);
-            audio_play_tone(659, 150);  // E5
-            audio_delay_ms(30);
-            audio_play_tone(784, 150);  // G5
-            audio_delay_ms(30);
-            audio_play_tone(1047, 300); // C6
-            break;
-        }
-            
-        case SFX_SHUTDOWN:
-            audio_play_tone(784, 150);  // G5
-            audio_delay_ms(50);
-            audio_play_tone(523, 150);  // C5
-            audio_delay_ms(50);
-            audio_play_tone(392, 300);  // G4
-            break;
-            
-        case SFX_NOTIFICATION:
-            audio_play_tone(880, 100);  // A5
-            audio_delay_ms(50);
-            audio_play_tone(1109, 150); // C#6
-            break;
-            
-        case SFX_KEYPRESS:
-            audio_play_tone(2000, 10);
-            break;
-    }
+    sequence_start(effects[effect], 0);
 }
 
-void audio_play_melody(const note_t* melody) {
+void audio_start_melody(const note_t* melody) {
     if (!audio_enabled || !melody) return;
     
-    for (int i = 0; melody[i].frequency != 0 || melody[i].duration != 0; i++) {
-        if (melody[i].frequency == 0) {
-            // Rest
-            audio_delay_ms(melody[i].duration);
-        } else {
-            audio_play_tone(melody[i].frequency, melody[i].duration);
-        }
-        // Small gap between notes
-        audio_delay_ms(20);
+    sequence_start(melody, MELODY_GAP_MS);
+}
+
+void audio_play_melody(const note_t* melody) {
+    audio_start_melody(melody);
+    while (audio_sequence_playing()) {
+        hlt();
     }
 }
 
@@ -162,6 +197,7 @@ uint8_t audio_get_volume(void) {
 void audio_enable(bool enable) {
     audio_enabled = enable;
     if (!enable) {
+        audio_stop_sequence();
         audio_stop();
     }
 }
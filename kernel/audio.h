@@ -55,12 +55,22 @@ void audio_play_tone(uint16_t frequency, uint16_t duration_ms);
 // Stop current tone
 void audio_stop(void);
 
-// Play a predefined sound effect
+// Start a predefined sound effect; it plays in the background
 void audio_play_effect(sound_effect_t effect);
 
-// Play a melody (array of notes, terminated by {0, 0})
+// Start a melody (array of notes, terminated by {0, 0}) playing in the
+// background
+void audio_start_melody(const note_t* melody);
+
+// Play a melody and wait for it to finish; needs interrupts on
 void audio_play_melody(const note_t* melody);
 
+// Whether an effect or melody is still playing
+bool audio_sequence_playing(void);
+
+// Cut off the effect or melody playing
+void audio_stop_sequence(void);
+
 // Set master volume (0-100) - affects duration/intensity simulation
 void audio_set_volume(uint8_t volume);
 
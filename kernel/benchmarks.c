@@ -0,0 +1,208 @@
+#include "kbench.h"
+#include "string.h"
+#include "memory.h"
+#include "vga.h"
+#include "atom.h"
+#include "apps/css.h"
+#include "apps/javascript.h"
+
+// Benchmarks run by the shell's "bench" command. Each body is one call of
+// the code being measured; buffers live in statics so the timed loop only
+// pays for the work itself.
+
+#define BENCH_BUFFER 16384
+
+static char src[BENCH_BUFFER];
+static char dst[BENCH_BUFFER];
+
+// A page of HTML-like text, built on first use, that the string scans run
+// over; it ends in "</script>" so strstr has to walk all of it
+static const char* bench_text(void) {
+    static bool built = false;
+
+    if (!built) {
+        size_t len = 0;
+        while (len + 64 < BENCH_BUFFER) {
+            len += ksnprintf(src + len, BENCH_BUFFER - len,
+                             "<p class=\"item%u\">line %u of the page</p>\n",
+                             (unsigned)(len % 97), (unsigned)len);
+        }
+        strcpy(src + len, "</script>");
+        built = true;
+    }
+    return src;
+}
+
+// --- string.c ---
+
+KBENCH(memcpy_64) {
+    memcpy(dst, src, 64);
+    KBENCH_KEEP(dst);
+}
+
+KBENCH(memcpy_4k) {
+    memcpy(dst, src, 4096);
+    KBENCH_KEEP(dst);
+}
+
+KBENCH(memset_4k) {
+    memset(dst, 0x20, 4096);
+    KBENCH_KEEP(dst);
+}
+
+KBENCH(strlen_16k) {
+    KBENCH_KEEP(strlen(bench_text()));
+}
+
+KBENCH(strchr_16k) {
+    KBENCH_KEEP(strchr(bench_text(), '\r'));
+}
+
+KBENCH(strcmp_ident) {
+    static const char* a = "background-color";
+    static const char* b = "background-colour";
+    KBENCH_KEEP(strcmp(a, b));
+}
+
+KBENCH(strstr_script) {
+    KBENCH_KEEP(strstr(bench_text(), "</script>"));
+}
+
+KBENCH(ksnprintf) {
+    char buf[64];
+    KBENCH_KEEP(ksnprintf(buf, sizeof(buf), "%s: %d of %u (0x%08x)", "item", -42, 1000u, 0xBEEFu));
+}
+
+// --- memory.c ---
+
+KBENCH(kmalloc_64) {
+    void* p = kmalloc(64);
+    KBENCH_KEEP(p);
+    kfree(p);
+}
+
+KBENCH(kmalloc_2k) {
+    void* p = kmalloc(2048);
+    KBENCH_KEEP(p);
+    kfree(p);
+}
+
+KBENCH(kcalloc_256) {
+    void* p = kcalloc(1, 256);
+    KBENCH_KEEP(p);
+    kfree(p);
+}
+
+KBENCH(krealloc_grow) {
+    void* p = kmalloc(32);
+    p = krealloc(p, 512);
+    KBENCH_KEEP(p);
+    kfree(p);
+}
+
+// --- vga.c ---
+
+// Both draw on the bottom row; a full-width string would scroll
+KBENCH(vga_puts_at) {
+    static const char line[] =
+        "                                        "
+        "                                       ";
+    vga_puts_at(line, 0, VGA_HEIGHT - 1);
+}
+
+KBENCH(vga_fill_row) {
+    vga_fill_area(0, VGA_HEIGHT - 1, VGA_WIDTH, 1, ' ',
+                  vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+}
+
+// --- CSS ---
+
+static const char bench_css[] =
+    "body { color: lightgrey; background-color: black; }\n"
+    "h1 { color: yellow; font-weight: bold; text-align: center; }\n"
+    "h2 { color: lightcyan; font-weight: bold; }\n"
+    "h3 { color: cyan; }\n"
+    "p { margin: 1; }\n"
+    "a { color: lightblue; text-decoration: underline; }\n"
+    "em { font-style: italic; }\n"
+    "strong { font-weight: bold; }\n"
+    "code { color: lightgreen; }\n"
+    "pre { color: lightgreen; display: block; }\n"
+    "ul { margin: 2; }\n"
+    "li { color: white; }\n"
+    "blockquote { color: darkgrey; padding: 2; }\n"
+    ".nav { background-color: blue; color: white; }\n"
+    ".menu { display: block; }\n"
+    ".warning { color: yellow; font-weight: bold; }\n"
+    ".error { color: lightred; }\n"
+    ".ok { color: lightgreen; }\n"
+    ".muted { color: darkgrey; }\n"
+    ".hidden { display: none; }\n"
+    ".center { text-align: center; }\n"
+    ".right { text-align: right; }\n"
+    ".item3 { color: magenta; }\n"
+    ".item7 { color: brown; }\n"
+    "#header { background-color: blue; }\n"
+    "#footer { color: darkgrey; }\n"
+    "#main { margin: 1; }\n"
+    "#sidebar { display: none; }\n"
+    "#title { color: white; font-weight: bold; }\n"
+    "#status { color: lightgreen; }\n"
+    "#log { color: lightgrey; }\n"
+    "#content { padding: 1; }\n";
+
+static css_stylesheet_t bench_sheet;
+static arena_t* css_arena = NULL;
+
+// Parse bench_css into bench_sheet; false if there is no memory for it
+static bool bench_stylesheet(void) {
+    if (css_arena == NULL) {
+        css_arena = arena_create(4096);
+        if (css_arena == NULL) return false;
+        css_set_arena(&bench_sheet, css_arena);
+    }
+    css_reset_stylesheet(&bench_sheet);
+    arena_reset(css_arena);
+    return css_parse(bench_css, &bench_sheet);
+}
+
+KBENCH(css_parse) {
+    KBENCH_KEEP(bench_stylesheet());
+}
+
+KBENCH(css_compute_style) {
+    static bool parsed = false;
+    static atom_t item;
+    css_computed_style_t style;
+
+    if (!parsed) {
+        parsed = bench_stylesheet();
+        item = atom_intern("item7");
+    }
+    css_compute_style(ATOM_LI, item, ATOM_NONE, NULL, &bench_sheet, &style);
+    KBENCH_KEEP(style.color);
+}
+
+// --- JavaScript ---
+
+static const char bench_js[] =
+    "var a = 6;\n"
+    "var b = a * 7 + 1;\n"
+    "var label = 'total: ' + b;\n"
+    "if (b > 40) { a = b - 1; }\n";
+
+KBENCH(js_execute) {
+    static js_context_t ctx;
+    static arena_t* arena = NULL;
+
+    if (arena == NULL) {
+        arena = arena_create(4096);
+        if (arena == NULL) return;
+        js_init(&ctx);
+        js_set_arena(&ctx, arena);
+    }
+    js_reset(&ctx);
+    arena_reset(arena);
+    js_value_t result = js_execute(&ctx, bench_js);
+    KBENCH_KEEP(result.type);
+}
@@ -0,0 +1,157 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// CPUID feature bits (leaf 1)
+#define CPUID_EDX_PSE   (1 << 3)    // 4 MB pages
+#define CPUID_EDX_TSC   (1 << 4)    // Time stamp counter
+#define CPUID_EDX_MSR   (1 << 5)    // RDMSR/WRMSR
+#define CPUID_EDX_APIC  (1 << 9)    // On-chip local APIC
+#define CPUID_EDX_PGE   (1 << 13)   // Global pages
+#define CPUID_EDX_FXSR  (1 << 24)   // FXSAVE/FXRSTOR
+#define CPUID_EDX_SSE2  (1 << 26)   // SSE2 instructions
+#define CPUID_ECX_HYPERVISOR (1u << 31)  // Running under a hypervisor
+
+// CPUID feature bits (leaf 7, subleaf 0)
+#define CPUID_7_EBX_ERMS (1 << 9)   // Fast REP MOVSB/STOSB
+
+// CPUID feature bits (leaf 0x80000001)
+#define CPUID_EXT_EDX_RDTSCP (1u << 27)  // RDTSCP instruction
+
+// CPUID feature bits (leaf 0x80000007)
+#define CPUID_EXT7_EDX_INVTSC (1 << 8)  // TSC rate constant in all P/C-states
+
+// Model-specific registers
+#define MSR_APIC_BASE        0x1B
+#define MSR_APIC_BASE_ENABLE (1u << 11)
+
+// Control register bits
+#define CR0_MP  (1u << 1)           // Monitor coprocessor
+#define CR0_EM  (1u << 2)           // x87 emulation (must be clear for SSE)
+#define CR0_WP  (1u << 16)          // Write-protect in ring 0
+#define CR0_PG  (1u << 31)          // Paging enable
+#define CR4_PSE (1u << 4)           // Page size extension
+#define CR4_OSFXSR     (1u << 9)    // OS supports FXSAVE and SSE
+#define CR4_OSXMMEXCPT (1u << 10)   // OS handles SIMD exceptions
+
+// Execute CPUID for the given leaf
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx,
+                         uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile ("cpuid"
+                      : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                      : "a"(leaf), "c"(0));
+}
+
+// Check whether the CPUID instruction exists (EFLAGS.ID can be toggled)
+static inline bool cpuid_available(void) {
+#if defined(__x86_64__)
+    return true;
+#else
+    uint32_t before, after;
+    __asm__ volatile ("pushfl\n\t"
+                      "pushfl\n\t"
+                      "xorl $0x200000, (%%esp)\n\t"
+                      "popfl\n\t"
+                      "pushfl\n\t"
+                      "popl %0\n\t"
+                      "popl %1\n\t"
+                      "pushl %1\n\t"
+                      "popfl"
+                      : "=&r"(after), "=&r"(before));
+    return ((after ^ before) & 0x200000) != 0;
+#endif
+}
+
+// Feature flags from CPUID leaf 1 EDX, or 0 without CPUID
+static inline uint32_t cpu_features_edx(void) {
+    uint32_t a, b, c, d;
+    if (!cpuid_available()) return 0;
+    cpuid(1, &a, &b, &c, &d);
+    return d;
+}
+
+// Feature flags from CPUID leaf 1 ECX, or 0 without CPUID
+static inline uint32_t cpu_features_ecx(void) {
+    uint32_t a, b, c, d;
+    if (!cpuid_available()) return 0;
+    cpuid(1, &a, &b, &c, &d);
+    return c;
+}
+
+// Highest extended CPUID leaf, or 0 if there are none
+static inline uint32_t cpu_max_ext_leaf(void) {
+    uint32_t a, b, c, d;
+    if (!cpuid_available()) return 0;
+    cpuid(0x80000000, &a, &b, &c, &d);
+    return (a & 0x80000000) ? a : 0;
+}
+
+// Read the time stamp counter (no ordering against other instructions)
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Highest standard CPUID leaf, or 0 without CPUID
+static inline uint32_t cpu_max_leaf(void) {
+    uint32_t a, b, c, d;
+    if (!cpuid_available()) return 0;
+    cpuid(0, &a, &b, &c, &d);
+    return a;
+}
+
+static inline uint32_t read_cr0(void) {
+    uint32_t v;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v) {
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr2(void) {
+    uint32_t v;
+    __asm__ volatile ("mov %%cr2, %0" : "=r"(v));
+    return v;
+}
+
+static inline uint32_t read_cr3(void) {
+    uint32_t v;
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr3(uint32_t v) {
+    __asm__ volatile ("mov %0, %%cr3" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t v;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint32_t v) {
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(v) : "memory");
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t v) {
+    __asm__ volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)v), "d"((uint32_t)(v >> 32)));
+}
+
+// Flush one TLB entry
+static inline void invlpg(void* addr) {
+    __asm__ volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+#endif // CPU_H
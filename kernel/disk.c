@@ -2,6 +2,7 @@
 #include "io.h"
 #include "string.h"
 #include "memory.h"
+#include "ktimer.h"
 
 // Global disk manager
 static disk_manager_t g_disk_manager;
@@ -10,32 +11,60 @@ static disk_manager_t g_disk_manager;
 static uint8_t virtual_disk[VIRTUAL_DISK_SIZE];
 static bool virtual_disk_initialized = false;
 
+// Command timeout; set by ata_timer when a wait has gone on too long
+static ktimer_t ata_timer;
+static volatile bool ata_timed_out = false;
+
+static void ata_timeout(void* data) {
+    (void)data;
+    ata_timed_out = true;
+}
+
+// Start timing a wait on the drive
+static void ata_timeout_start(void) {
+    ata_timed_out = false;
+    ktimer_start(&ata_timer, ATA_TIMEOUT_MS);
+}
+
+// Whether a wait has gone on too long. The timer can only fire while
+// interrupts are delivered, so a count of status reads backs it up.
+static bool ata_timeout_expired(uint32_t* reads) {
+    return ata_timed_out || ++*reads > ATA_TIMEOUT_READS;
+}
+
 // Wait for disk to be ready
 static bool ata_wait_ready(uint16_t io_base) {
-    int timeout = 100000;
-    while (timeout--) {
+    uint32_t reads = 0;
+    ata_timeout_start();
+    while (!ata_timeout_expired(&reads)) {
         uint8_t status = inb(io_base + 7);
         if (!(status & ATA_SR_BSY)) {
+            ktimer_cancel(&ata_timer);
             return true;
         }
     }
+    ktimer_cancel(&ata_timer);
     return false;
 }
 
 // Wait for data request
 static bool ata_wait_drq(uint16_t io_base) {
-    int timeout = 100000;
-    while (timeout--) {
+    uint32_t reads = 0;
+    ata_timeout_start();
+    while (!ata_timeout_expired(&reads)) {
         uint8_t status = inb(io_base + 7);
         if (!(status & ATA_SR_BSY)) {
             if (status & ATA_SR_DRQ) {
+                ktimer_cancel(&ata_timer);
                 return true;
             }
             if (status & ATA_SR_ERR) {
+                ktimer_cancel(&ata_timer);
                 return false;
             }
         }
     }
+    ktimer_cancel(&ata_timer);
     return false;
 }
 
@@ -63,6 +92,11 @@ static bool ata_identify(uint16_t io_base, uint16_t control_port, bool slave, di
     // Select drive
     ata_select_drive(io_base, slave);
     
+    // A floating bus (no controller) reads all ones
+    if (inb(io_base + 7) == 0xFF) {
+        return false;
+    }
+    
     // Wait for drive ready
     if (!ata_wait_ready(io_base)) {
         return false;
@@ -84,11 +118,7 @@ static bool ata_identify(uint16_t io_base, uint16_t control_port, bool slave, di
     }
     
     // Wait for BSY to clear
-    int timeout = 100000;
-    while ((status & ATA_SR_BSY) && timeout--) {
-        status = inb(io_base + 7);
-    }
-    if (timeout <= 0) {
+    if (!ata_wait_ready(io_base)) {
         return false;
     }
     
@@ -173,6 +203,7 @@ static bool ata_identify(uint16_t io_base, uint16_t control_port, bool slave, di
 
 void disk_init(void) {
     memset(&g_disk_manager, 0, sizeof(g_disk_manager));
+    ktimer_init(&ata_timer, ata_timeout, NULL);
     
     // Initialize virtual disk
     memset(virtual_disk, 0, VIRTUAL_DISK_SIZE);
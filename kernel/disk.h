@@ -45,6 +45,12 @@
 #define ATA_SR_IDX               0x02    // Index
 #define ATA_SR_ERR               0x01    // Error
 
+// Longest wait for the drive to leave BSY or raise DRQ (ms)
+#define ATA_TIMEOUT_MS           1000
+// Status reads a wait gives up after if the timer can't fire; each read
+// takes about a microsecond on real hardware
+#define ATA_TIMEOUT_READS        1000000
+
 // Drive types
 typedef enum {
     DISK_TYPE_NONE = 0,
@@ -0,0 +1,112 @@
+#include "dma.h"
+#include "pmm.h"
+#include "string.h"
+
+// The pool, tracked in DMA_UNIT pieces
+static uint32_t pool_base = 0;
+static uint32_t unit_bitmap[DMA_POOL_UNITS / 32];
+static uint16_t run_length[DMA_POOL_UNITS];  // Units, on an allocation's first unit
+
+// Statistics
+static size_t free_units = 0;
+static uint32_t alloc_count = 0;
+static uint32_t failed_allocs = 0;
+
+static inline bool unit_used(uint32_t unit) {
+    return (unit_bitmap[unit / 32] >> (unit % 32)) & 1;
+}
+
+static void mark_units(uint32_t first, uint32_t count, bool used) {
+    for (uint32_t unit = first; unit < first + count; unit++) {
+        if (used) {
+            unit_bitmap[unit / 32] |= 1u << (unit % 32);
+        } else {
+            unit_bitmap[unit / 32] &= ~(1u << (unit % 32));
+        }
+    }
+}
+
+static bool units_free(uint32_t first, uint32_t count) {
+    for (uint32_t unit = first; unit < first + count; unit++) {
+        if (unit_used(unit)) return false;
+    }
+    return true;
+}
+
+bool dma_init(void) {
+    memset(unit_bitmap, 0, sizeof(unit_bitmap));
+    memset(run_length, 0, sizeof(run_length));
+    alloc_count = 0;
+    failed_allocs = 0;
+
+    pool_base = (uint32_t)alloc_pages_below(DMA_POOL_ORDER, DMA_LOW_LIMIT);
+    free_units = pool_base ? DMA_POOL_UNITS : 0;
+    return pool_base != 0;
+}
+
+void* dma_alloc(size_t size, size_t align, size_t boundary, uint32_t* phys) {
+    if (align < DMA_UNIT) align = DMA_UNIT;
+
+    if (pool_base == 0 || size == 0 || size > DMA_POOL_SIZE ||
+        (align & (align - 1)) || (boundary & (boundary - 1)) ||
+        (boundary && size > boundary)) {
+        failed_allocs++;
+        return NULL;
+    }
+
+    uint32_t units = (size + DMA_UNIT - 1) / DMA_UNIT;
+    uint32_t bytes = units * DMA_UNIT;
+    uint32_t pool_end = pool_base + DMA_POOL_SIZE;
+    uint32_t addr = (pool_base + align - 1) & ~(uint32_t)(align - 1);
+
+    while (addr >= pool_base && addr + bytes <= pool_end) {
+        uint32_t last = addr + bytes - 1;
+
+        // Crossing a boundary: restart at the boundary, which is aligned
+        // too since a buffer no bigger than the boundary only crosses one
+        // when boundary >= align
+        if (boundary && ((addr ^ last) & ~(uint32_t)(boundary - 1))) {
+            addr = (addr | (uint32_t)(boundary - 1)) + 1;
+            continue;
+        }
+
+        uint32_t first = (addr - pool_base) / DMA_UNIT;
+        if (units_free(first, units)) {
+            mark_units(first, units, true);
+            run_length[first] = (uint16_t)units;
+            free_units -= units;
+            alloc_count++;
+            if (phys) *phys = addr;
+            return (void*)addr;
+        }
+        addr += align;
+    }
+
+    failed_allocs++;
+    return NULL;
+}
+
+void dma_free(void* ptr) {
+    uint32_t addr = (uint32_t)ptr;
+
+    if (pool_base == 0 || addr < pool_base || addr >= pool_base + DMA_POOL_SIZE) return;
+    if ((addr - pool_base) % DMA_UNIT) return;
+
+    uint32_t first = (addr - pool_base) / DMA_UNIT;
+    uint32_t units = run_length[first];
+    if (units == 0) return;  // Not the start of an allocation
+
+    mark_units(first, units, false);
+    run_length[first] = 0;
+    free_units += units;
+}
+
+void dma_get_stats(dma_stats_t* stats) {
+    if (stats == NULL) return;
+
+    stats->base = pool_base;
+    stats->size = pool_base ? DMA_POOL_SIZE : 0;
+    stats->free = free_units * DMA_UNIT;
+    stats->alloc_count = alloc_count;
+    stats->failed_allocs = failed_allocs;
+}
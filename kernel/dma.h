@@ -0,0 +1,42 @@
+#ifndef DMA_H
+#define DMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Pool of physically contiguous memory for device buffers. It is taken
+// from the page allocator below 16 MB so ISA DMA can reach it too, and
+// sits in the identity map, so virtual and physical addresses match.
+// x86 keeps bus-master DMA cache-coherent; no flushing is needed.
+
+#define DMA_LOW_LIMIT   0x1000000     // 16 MB, the ISA DMA limit
+#define DMA_POOL_ORDER  6             // 2^6 pages = 256 KB
+#define DMA_POOL_SIZE   (4096u << DMA_POOL_ORDER)
+#define DMA_UNIT        512           // Allocation granularity
+#define DMA_POOL_UNITS  (DMA_POOL_SIZE / DMA_UNIT)
+
+// DMA pool statistics
+typedef struct {
+    uint32_t base;            // Physical start of the pool, 0 if none
+    size_t size;
+    size_t free;
+    uint32_t alloc_count;
+    uint32_t failed_allocs;
+} dma_stats_t;
+
+// Reserve the pool; call after pmm_init
+bool dma_init(void);
+
+// Allocate a buffer aligned to align that doesn't cross a multiple of
+// boundary (0 for no limit); both must be powers of two. Stores the bus
+// address in *phys if phys is not NULL.
+void* dma_alloc(size_t size, size_t align, size_t boundary, uint32_t* phys);
+
+// Free a buffer from dma_alloc
+void dma_free(void* ptr);
+
+// Get pool statistics
+void dma_get_stats(dma_stats_t* stats);
+
+#endif // DMA_H
@@ -1,6 +1,7 @@
 #include "gui.h"
 #include "string.h"
 #include "memory.h"
+#include "slab.h"
 #include "keyboard.h"
 
 // Global desktop
@@ -31,11 +32,44 @@ static gui_color_scheme_t g_colors = {
 // Element ID counter
 static int g_element_id_counter = 0;
 
+// Object caches for windows and elements
+static kmem_cache_t* window_cache = NULL;
+static kmem_cache_t* button_cache = NULL;
+static kmem_cache_t* label_cache = NULL;
+static kmem_cache_t* textbox_cache = NULL;
+static kmem_cache_t* checkbox_cache = NULL;
+static kmem_cache_t* listbox_cache = NULL;
+static kmem_cache_t* progress_cache = NULL;
+
 void gui_init(void) {
     memset(&g_desktop, 0, sizeof(gui_desktop_t));
     g_desktop.desktop_color = VGA_COLOR_CYAN;
     g_desktop.wallpaper_char = ' ';
     g_element_id_counter = 0;
+
+    if (!window_cache) {
+        window_cache = kmem_cache_create("gui_window", sizeof(gui_window_t), 0, NULL);
+        button_cache = kmem_cache_create("gui_button", sizeof(gui_button_t), 0, NULL);
+        label_cache = kmem_cache_create("gui_label", sizeof(gui_label_t), 0, NULL);
+        textbox_cache = kmem_cache_create("gui_textbox", sizeof(gui_textbox_t), 0, NULL);
+        checkbox_cache = kmem_cache_create("gui_checkbox", sizeof(gui_checkbox_t), 0, NULL);
+        listbox_cache = kmem_cache_create("gui_listbox", sizeof(gui_listbox_t), 0, NULL);
+        progress_cache = kmem_cache_create("gui_progress", sizeof(gui_progress_bar_t), 0, NULL);
+    }
+}
+
+// Return an element to the cache it was allocated from
+static void gui_free_element(gui_element_t* element) {
+    switch (element->type) {
+        case GUI_ELEMENT_WINDOW:       kmem_cache_free(window_cache, element); break;
+        case GUI_ELEMENT_BUTTON:       kmem_cache_free(button_cache, element); break;
+        case GUI_ELEMENT_LABEL:        kmem_cache_free(label_cache, element); break;
+        case GUI_ELEMENT_TEXTBOX:      kmem_cache_free(textbox_cache, element); break;
+        case GUI_ELEMENT_CHECKBOX:     kmem_cache_free(checkbox_cache, element); break;
+        case GUI_ELEMENT_LISTBOX:      kmem_cache_free(listbox_cache, element); break;
+        case GUI_ELEMENT_PROGRESS_BAR: kmem_cache_free(progress_cache, element); break;
+        default: break;
+    }
 }
 
 gui_desktop_t* gui_get_desktop(void) {
@@ -54,7 +88,7 @@ void gui_set_colors(gui_color_scheme_t* scheme) {
 
 // Window functions
 gui_window_t* gui_create_window(const char* title, int x, int y, int width, int height) {
-    gui_window_t* window = (gui_window_t*)kmalloc(sizeof(gui_window_t));
+    gui_window_t* window = (gui_window_t*)kmem_cache_alloc(window_cache);
     if (!window) return NULL;
     
     memset(window, 0, sizeof(gui_window_t));
@@ -107,11 +141,11 @@ void gui_destroy_window(gui_window_t* window) {
     // Free child elements
     for (int i = 0; i < window->element_count; i++) {
         if (window->elements[i]) {
-            kfree(window->elements[i]);
+            gui_free_element(window->elements[i]);
         }
     }
     
-    kfree(window);
+    kmem_cache_free(window_cache, window);
 }
 
 void gui_show_window(gui_window_t* window) {
@@ -150,7 +184,7 @@ void gui_window_add_element(gui_window_t* window, gui_element_t* element) {
 
 // Element creation functions
 gui_button_t* gui_create_button(const char* text, int x, int y, int width) {
-    gui_button_t* button = (gui_button_t*)kmalloc(sizeof(gui_button_t));
+    gui_button_t* button = (gui_button_t*)kmem_cache_alloc(button_cache);
     if (!button) return NULL;
     
     memset(button, 0, sizeof(gui_button_t));
@@ -171,7 +205,7 @@ gui_button_t* gui_create_button(const char* text, int x, int y, int width) {
 }
 
 gui_label_t* gui_create_label(const char* text, int x, int y) {
-    gui_label_t* label = (gui_label_t*)kmalloc(sizeof(gui_label_t));
+    gui_label_t* label = (gui_label_t*)kmem_cache_alloc(label_cache);
     if (!label) return NULL;
     
     memset(label, 0, sizeof(gui_label_t));
@@ -192,7 +226,7 @@ gui_label_t* gui_create_label(const char* text, int x, int y) {
 }
 
 gui_textbox_t* gui_create_textbox(int x, int y, int width, int max_length) {
-    gui_textbox_t* textbox = (gui_textbox_t*)kmalloc(sizeof(gui_textbox_t));
+    gui_textbox_t* textbox = (gui_textbox_t*)kmem_cache_alloc(textbox_cache);
     if (!textbox) return NULL;
     
     memset(textbox, 0, sizeof(gui_textbox_t));
@@ -214,7 +248,7 @@ gui_textbox_t* gui_create_textbox(int x, int y, int width, int max_length) {
 }
 
 gui_checkbox_t* gui_create_checkbox(const char* text, int x, int y) {
-    gui_checkbox_t* checkbox = (gui_checkbox_t*)kmalloc(sizeof(gui_checkbox_t));
+    gui_checkbox_t* checkbox = (gui_checkbox_t*)kmem_cache_alloc(checkbox_cache);
     if (!checkbox) return NULL;
     
     memset(checkbox, 0, sizeof(gui_checkbox_t));
@@ -235,7 +269,7 @@ gui_checkbox_t* gui_create_checkbox(const char* text, int x, int y) {
 }
 
 gui_listbox_t* gui_create_listbox(int x, int y, int width, int height) {
-    gui_listbox_t* listbox = (gui_listbox_t*)kmalloc(sizeof(gui_listbox_t));
+    gui_listbox_t* listbox = (gui_listbox_t*)kmem_cache_alloc(listbox_cache);
     if (!listbox) return NULL;
     
     memset(listbox, 0, sizeof(gui_listbox_t));
@@ -258,7 +292,7 @@ gui_listbox_t* gui_create_listbox(int x, int y, int width, int height) {
 }
 
 gui_progress_bar_t* gui_create_progress_bar(int x, int y, int width) {
-    gui_progress_bar_t* bar = (gui_progress_bar_t*)kmalloc(sizeof(gui_progress_bar_t));
+    gui_progress_bar_t* bar = (gui_progress_bar_t*)kmem_cache_alloc(progress_cache);
     if (!bar) return NULL;
     
     memset(bar, 0, sizeof(gui_progress_bar_t));
@@ -2,13 +2,19 @@
 #include "io.h"
 #include "vga.h"
 #include "string.h"
+#include "cpu.h"
+#include "apic.h"
+#include "work.h"
 
 // IDT with 256 entries
 static idt_entry_t idt[256];
 static idt_ptr_t idt_ptr;
 
 // IRQ handlers array
-static irq_handler_t irq_handlers[16] = { 0 };
+static irq_handler_t irq_handlers[IRQ_COUNT] = { 0 };
+
+// Exception handlers array
+static isr_handler_t isr_handlers[32] = { 0 };
 
 // Exception messages
 static const char* exception_messages[] = {
@@ -152,22 +158,52 @@ void idt_init(void) {
     idt_set_gate(45, (uint32_t)irq13, 0x08, 0x8E);
     idt_set_gate(46, (uint32_t)irq14, 0x08, 0x8E);
     idt_set_gate(47, (uint32_t)irq15, 0x08, 0x8E);
+    idt_set_gate(APIC_TIMER_VECTOR, (uint32_t)irq16, 0x08, 0x8E);
+    idt_set_gate(APIC_SPURIOUS_VECTOR, (uint32_t)apic_spurious, 0x08, 0x8E);
     
     // Load IDT
     idt_flush((uint32_t)&idt_ptr);
 }
 
 void irq_register_handler(int irq, irq_handler_t handler) {
-    if (irq >= 0 && irq < 16) {
+    if (irq >= 0 && irq < IRQ_COUNT) {
         irq_handlers[irq] = handler;
     }
 }
 
+void irq_unmask(int irq) {
+    if (irq < 0 || irq >= 16) return;
+
+    if (apic_enabled()) {
+        apic_set_irq_masked(irq, false);
+    } else if (irq < 8) {
+        outb(0x21, inb(0x21) & ~(1 << irq));
+    } else {
+        outb(0xA1, inb(0xA1) & ~(1 << (irq - 8)));
+        outb(0x21, inb(0x21) & ~0x04);  // Cascade
+    }
+}
+
+void isr_register_handler(int num, isr_handler_t handler) {
+    if (num >= 0 && num < 32) {
+        isr_handlers[num] = handler;
+    }
+}
+
 // ISR handler (called from assembly)
 void isr_handler(registers_t* regs) {
+    // Give a registered handler the chance to resolve the fault
+    if (regs->int_no < 32 && isr_handlers[regs->int_no] &&
+        isr_handlers[regs->int_no](regs)) {
+        return;
+    }
+    
     vga_set_color(vga_entry_color(VGA_COLOR_WHITE, VGA_COLOR_RED));
     vga_printf("\n*** EXCEPTION: %s ***\n", exception_messages[regs->int_no]);
     vga_printf("Error Code: 0x%X\n", regs->err_code);
+    if (regs->int_no == 14) {
+        vga_printf("Fault Address: 0x%X\n", read_cr2());
+    }
     vga_printf("EIP: 0x%X  CS: 0x%X  EFLAGS: 0x%X\n", regs->eip, regs->cs, regs->eflags);
     vga_printf("EAX: 0x%X  EBX: 0x%X  ECX: 0x%X  EDX: 0x%X\n", regs->eax, regs->ebx, regs->ecx, regs->edx);
     vga_printf("ESP: 0x%X  EBP: 0x%X  ESI: 0x%X  EDI: 0x%X\n", regs->esp, regs->ebp, regs->esi, regs->edi);
@@ -183,15 +219,24 @@ void isr_handler(registers_t* regs) {
 void irq_handler(registers_t* regs) {
     // Call registered handler if exists
     int irq = regs->int_no - 32;
-    if (irq >= 0 && irq < 16 && irq_handlers[irq]) {
+    if (irq >= 0 && irq < IRQ_COUNT && irq_handlers[irq]) {
         irq_handlers[irq](regs);
     }
     
-    // Send EOI (End of Interrupt) to PIC
-    if (regs->int_no >= 40) {
-        // Send to slave PIC
-        outb(0xA0, 0x20);
+    if (apic_enabled()) {
+        // One register write acknowledges it at the local APIC
+        apic_eoi();
+    } else {
+        // Send EOI (End of Interrupt) to PIC
+        if (regs->int_no >= 40) {
+            // Send to slave PIC
+            outb(0xA0, 0x20);
+        }
+        // Send to master PIC
+        outb(0x20, 0x20);
     }
-    // Send to master PIC
-    outb(0x20, 0x20);
+    
+    // Bottom halves the handler queued run now that the controller can
+    // deliver the next IRQ, with interrupts enabled
+    work_run();
 }
@@ -2,6 +2,7 @@
 #define IDT_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 // IDT entry structure
 typedef struct {
@@ -26,18 +27,34 @@ typedef struct {
     uint32_t eip, cs, eflags, useresp, ss;
 } registers_t;
 
+// IRQ lines: the 16 ISA IRQs on vectors 32-47, then the local APIC timer
+// on vector 48
+#define IRQ_APIC_TIMER 16
+#define IRQ_COUNT      17
+
 // IRQ handler type
 typedef void (*irq_handler_t)(registers_t*);
 
+// Exception handler type; returns true if the fault was resolved and the
+// faulting instruction can be restarted
+typedef bool (*isr_handler_t)(registers_t*);
+
 // Initialize IDT
 void idt_init(void);
 
 // Set an IDT gate
 void idt_set_gate(uint8_t num, uint32_t base, uint16_t selector, uint8_t flags);
 
-// Register IRQ handler
+// Register IRQ handler; it runs with interrupts off, so it should queue
+// anything slow as deferred work (work.h)
 void irq_register_handler(int irq, irq_handler_t handler);
 
+// Let an ISA IRQ through, at the I/O APIC or the 8259
+void irq_unmask(int irq);
+
+// Register CPU exception handler (0-31)
+void isr_register_handler(int num, isr_handler_t handler);
+
 // ISR declarations
 extern void isr0(void);
 extern void isr1(void);
@@ -89,6 +106,10 @@ extern void irq12(void);
 extern void irq13(void);
 extern void irq14(void);
 extern void irq15(void);
+extern void irq16(void);
+
+// Local APIC spurious interrupt stub
+extern void apic_spurious(void);
 
 // IDT flush (defined in assembly)
 extern void idt_flush(uint32_t);
@@ -0,0 +1,143 @@
+#include "kbench.h"
+#include "cpu.h"
+#include "math64.h"
+#include "string.h"
+#include "sync.h"
+
+#define KBENCH_WARMUP     16        // Untimed calls before measuring
+#define KBENCH_SAMPLES    101       // Timed samples per benchmark
+#define KBENCH_TARGET     20000     // Cycles a sample should last
+#define KBENCH_MAX_BATCH  (1u << 20)
+
+// Registered benchmarks, from the linker script
+extern const kbench_t __kbench_start[];
+extern const kbench_t __kbench_end[];
+
+// How the counter is fenced, worked out on the first run
+static bool probed = false;
+static bool have_tsc = false;
+static bool have_rdtscp = false;
+static bool have_lfence = false;
+
+// Cost of an empty timed region, taken off every sample
+static uint64_t overhead = 0;
+
+static uint32_t samples[KBENCH_SAMPLES];
+
+// Counter read before the timed code: LFENCE keeps earlier instructions
+// from drifting past it; without SSE2, CPUID serialises instead
+static inline uint64_t tsc_begin(void) {
+    if (have_lfence) {
+        __asm__ volatile ("lfence" : : : "memory");
+    } else {
+        uint32_t a, b, c, d;
+        cpuid(0, &a, &b, &c, &d);
+    }
+    return rdtsc();
+}
+
+// Counter read after the timed code: RDTSCP waits for it to finish, and
+// the LFENCE stops later work from starting early
+static inline uint64_t tsc_end(void) {
+    uint32_t lo, hi;
+
+    if (have_rdtscp) {
+        __asm__ volatile ("rdtscp" : "=a"(lo), "=d"(hi) : : "ecx", "memory");
+        if (have_lfence) {
+            __asm__ volatile ("lfence" : : : "memory");
+        }
+        return ((uint64_t)hi << 32) | lo;
+    }
+    return tsc_begin();
+}
+
+static void probe(void) {
+    uint32_t edx = cpu_features_edx();
+    uint32_t a, b, c, d = 0;
+
+    if (cpu_max_ext_leaf() >= 0x80000001) {
+        cpuid(0x80000001, &a, &b, &c, &d);
+    }
+    have_tsc = (edx & CPUID_EDX_TSC) != 0;
+    have_lfence = (edx & CPUID_EDX_SSE2) != 0;
+    have_rdtscp = (d & CPUID_EXT_EDX_RDTSCP) != 0;
+
+    // Smallest of a few empty measurements
+    overhead = (uint64_t)-1;
+    for (int i = 0; have_tsc && i < 64; i++) {
+        uint64_t start = tsc_begin();
+        uint64_t cycles = tsc_end() - start;
+        if (cycles < overhead) overhead = cycles;
+    }
+    probed = true;
+}
+
+// Cycles for batch calls, less the timing overhead; interrupts are off
+// so a handler doesn't land in the sample
+static uint64_t time_batch(void (*fn)(void), uint32_t batch) {
+    uint32_t flags = irq_save();
+    uint64_t start = tsc_begin();
+    for (uint32_t i = 0; i < batch; i++) {
+        fn();
+    }
+    uint64_t cycles = tsc_end() - start;
+    irq_restore(flags);
+    return cycles > overhead ? cycles - overhead : 0;
+}
+
+static void sort_samples(uint32_t* values, int count) {
+    for (int i = 1; i < count; i++) {
+        uint32_t v = values[i];
+        int j = i;
+        while (j > 0 && values[j - 1] > v) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = v;
+    }
+}
+
+static void run_one(const kbench_t* bench, kbench_result_t* result) {
+    for (int i = 0; i < KBENCH_WARMUP; i++) {
+        bench->fn();
+    }
+
+    // Double the batch until one sample lasts long enough
+    uint32_t batch = 1;
+    while (batch < KBENCH_MAX_BATCH && time_batch(bench->fn, batch) < KBENCH_TARGET) {
+        batch *= 2;
+    }
+
+    for (int i = 0; i < KBENCH_SAMPLES; i++) {
+        uint64_t per_call = div_u64(time_batch(bench->fn, batch), batch);
+        samples[i] = per_call > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)per_call;
+    }
+    sort_samples(samples, KBENCH_SAMPLES);
+
+    result->name = bench->name;
+    result->batch = batch;
+    result->min = samples[0];
+    result->median = samples[KBENCH_SAMPLES / 2];
+    result->p99 = samples[(KBENCH_SAMPLES - 1) * 99 / 100];
+}
+
+bool kbench_available(void) {
+    if (!probed) probe();
+    return have_tsc;
+}
+
+int kbench_run(const char* pattern, kbench_report_fn report) {
+    int ran = 0;
+
+    if (!kbench_available()) return 0;
+
+    for (const kbench_t* bench = __kbench_start; bench < __kbench_end; bench++) {
+        if (pattern && *pattern && strstr(bench->name, pattern) == NULL) continue;
+
+        kbench_result_t result;
+        run_one(bench, &result);
+        if (report) report(&result);
+        ran++;
+    }
+    return ran;
+}
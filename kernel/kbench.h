@@ -0,0 +1,46 @@
+#ifndef KBENCH_H
+#define KBENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// In-kernel microbenchmarks. KBENCH(name) { ... } registers a body that
+// kbench_run times with the TSC: after a warm-up it is called in batches
+// long enough that reading the counter is noise, and every sample is
+// reported as cycles per call. Bodies keep any state in statics.
+
+typedef struct {
+    const char* name;
+    void (*fn)(void);
+} kbench_t;
+
+// The linker gathers the entries in .kbench, between __kbench_start and
+// __kbench_end
+#define KBENCH(name) \
+    static void kbench_fn_##name(void); \
+    static const kbench_t kbench_##name \
+        __attribute__((section(".kbench"), used, aligned(4))) = { #name, kbench_fn_##name }; \
+    static void kbench_fn_##name(void)
+
+// Make the compiler treat a value as used so the work isn't optimised out
+#define KBENCH_KEEP(value) __asm__ volatile ("" : : "g"(value) : "memory")
+
+// Cycles per call for one benchmark
+typedef struct {
+    const char* name;
+    uint32_t batch;           // Calls timed together per sample
+    uint32_t min;
+    uint32_t median;
+    uint32_t p99;
+} kbench_result_t;
+
+typedef void (*kbench_report_fn)(const kbench_result_t* result);
+
+// Whether there is a time stamp counter to measure with
+bool kbench_available(void);
+
+// Run every benchmark whose name contains pattern (all of them for NULL
+// or ""), calling report after each; returns how many ran
+int kbench_run(const char* pattern, kbench_report_fn report);
+
+#endif // KBENCH_H
@@ -8,6 +8,13 @@
 #include "idt.h"
 #include "keyboard.h"
 #include "memory.h"
+#include "atom.h"
+#include "pmm.h"
+#include "paging.h"
+#include "dma.h"
+#include "apic.h"
+#include "serial.h"
+#include "multiboot.h"
 #include "string.h"
 #include "shell.h"
 #include "io.h"
@@ -15,15 +22,11 @@
 #include "network.h"
 #include "gui.h"
 #include "audio.h"
+#include "timer.h"
 
 // Provided by the linker; marks the end of the kernel image
 extern uint32_t _kernel_end;
 
-// Align a value up to the nearest 4 KB boundary
-static inline uint32_t align4k(uint32_t addr) {
-    return (addr + 0xFFF) & ~0xFFF;
-}
-
 void kernel_panic(const char* message) {
     cli();
     
@@ -44,8 +47,6 @@ void kernel_panic(const char* message) {
 }
 
 void kernel_main(uint32_t magic, uint32_t* mboot_info) {
-    (void)mboot_info;  // Suppress unused warning for now
-    
     // Initialize VGA
     vga_init();
     
@@ -60,22 +61,95 @@ void kernel_main(uint32_t magic, uint32_t* mboot_info) {
     }
     vga_puts("[OK] Multiboot verified\n");
     
+    // Pick memcpy/memset strategies for this CPU
+    string_init();
+    vga_printf("[OK] Memory copy: %s\n", string_variant());
+    
+    // Initialize the serial port for debug output
+    vga_puts("[..] Initializing serial port...\n");
+    if (serial_init()) {
+        vga_puts("[OK] Serial port COM1 at 115200 baud\n");
+        serial_puts("MiniOS serial console\n");
+    } else {
+        vga_puts("[!!] No serial port found\n");
+    }
+    
     // Initialize IDT (Interrupt Descriptor Table)
     vga_puts("[..] Initializing IDT...\n");
     idt_init();
     vga_puts("[OK] IDT initialized\n");
     
+    // Initialize physical memory from the multiboot memory map
+    vga_puts("[..] Initializing physical memory...\n");
+    pmm_init((multiboot_info_t*)mboot_info, (uint32_t)&_kernel_end);
+    vga_printf("[OK] Physical memory: %u KB usable, %u KB free\n",
+               (uint32_t)(pmm_get_total() / 1024), (uint32_t)(pmm_get_free() / 1024));
+    
+    // Enable paging (identity map plus the demand-paged heap window)
+    vga_puts("[..] Enabling paging...\n");
+    paging_init();
+    vga_puts("[OK] Paging enabled\n");
+    
+    // Reserve low, physically contiguous memory for device buffers
+    vga_puts("[..] Reserving DMA pool...\n");
+    if (dma_init()) {
+        dma_stats_t dstats;
+        dma_get_stats(&dstats);
+        vga_printf("[OK] DMA pool: %u KB at 0x%X\n", (uint32_t)(dstats.size / 1024), dstats.base);
+    } else {
+        vga_puts("[!!] No memory below 16 MB for the DMA pool\n");
+    }
+    
     // Initialize memory manager
     vga_puts("[..] Initializing memory manager...\n");
-    uint32_t heap_start = align4k((uint32_t)&_kernel_end);
-    memory_init((void*)heap_start, KERNEL_HEAP_SIZE);
-    vga_printf("[OK] Heap: %u bytes at 0x%X (kernel end 0x%X)\n", KERNEL_HEAP_SIZE, heap_start, (uint32_t)&_kernel_end);
+    size_t heap_size = 0;
+    void* heap_start = paging_heap_grow(KERNEL_HEAP_SIZE, &heap_size);
+    if (heap_start == NULL) {
+        kernel_panic("Not enough memory for the kernel heap!");
+    }
+    memory_init(heap_start, heap_size);
+    memory_set_grow_handler(paging_heap_grow);
+    vga_printf("[OK] Heap: %u bytes at 0x%X (kernel end 0x%X)\n", (uint32_t)heap_size, (uint32_t)heap_start, (uint32_t)&_kernel_end);
+    
+    // Intern the names the browser, CSS and JS engines share
+    if (!atom_init()) {
+        kernel_panic("Not enough memory for the atom table!");
+    }
+    
+    // Move interrupt delivery to the APICs when the machine has them;
+    // drivers unmask their IRQs afterwards through irq_unmask either way
+    vga_puts("[..] Initializing APIC...\n");
+    if (apic_init()) {
+        apic_info_t ainfo;
+        apic_get_info(&ainfo);
+        vga_printf("[OK] Interrupts: I/O APIC (%d pins), local APIC %u at 0x%X\n",
+                   ainfo.gsi_count, ainfo.lapic_id, ainfo.lapic_base);
+    } else {
+        vga_puts("[OK] Interrupts: 8259 PIC (no APIC or MADT)\n");
+    }
     
     // Initialize keyboard
     vga_puts("[..] Initializing keyboard...\n");
     keyboard_init();
     vga_puts("[OK] Keyboard initialized\n");
     
+    // Start the system tick
+    vga_puts("[..] Starting system timer...\n");
+    timer_init(TIMER_HZ);
+    vga_printf("[OK] %s tick at %u Hz\n", timer_tick_source(), timer_get_hz());
+    if (timer_tsc_khz()) {
+        vga_printf("[OK] Clocksource: TSC at %u.%03u MHz\n",
+                   timer_tsc_khz() / 1000, timer_tsc_khz() % 1000);
+    } else {
+        vga_puts("[OK] Clocksource: PIT (no constant-rate TSC)\n");
+    }
+    
+    // Enable interrupts; the timer and keyboard unmasked their own IRQs,
+    // and from here on ksleep_ms can halt between ticks
+    vga_puts("[..] Enabling interrupts...\n");
+    sti();
+    vga_puts("[OK] Interrupts enabled\n");
+    
     // Initialize disk subsystem
     vga_puts("[..] Initializing disk subsystem...\n");
     disk_init();
@@ -96,19 +170,6 @@ void kernel_main(uint32_t magic, uint32_t* mboot_info) {
     gui_init();
     vga_puts("[OK] GUI initialized\n");
     
-    // Configure PIC interrupt masks: mask timer (IRQ0/bit0), keep keyboard (IRQ1/bit1) unmasked
-    vga_puts("[..] Configuring interrupt masks...\n");
-    uint8_t pic_mask = inb(0x21);
-    pic_mask |= 0x01;   // Mask timer interrupt (IRQ0)
-    pic_mask &= ~0x02;  // Unmask keyboard interrupt (IRQ1) - make sure it stays enabled
-    outb(0x21, pic_mask);
-    vga_puts("[OK] Interrupt masks configured\n");
-    
-    // Enable interrupts
-    vga_puts("[..] Enabling interrupts...\n");
-    sti();
-    vga_puts("[OK] Interrupts enabled\n");
-    
     // Boot complete
     vga_puts("\n");
     vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
@@ -13,8 +13,10 @@
 #define KERNEL_VERSION_MINOR 0
 #define KERNEL_VERSION_PATCH 0
 
-// Heap configuration (size is fixed, start is computed at runtime)
+// Heap configuration (the heap lives in a demand-paged virtual window; it
+// starts at KERNEL_HEAP_SIZE and grows in steps of at least KERNEL_HEAP_GROW)
 #define KERNEL_HEAP_SIZE  0x400000    // 4 MB
+#define KERNEL_HEAP_GROW  0x100000    // 1 MB
 
 // Function declarations
 void kernel_main(uint32_t magic, uint32_t* mboot_info);
@@ -2,6 +2,8 @@
 #include "idt.h"
 #include "io.h"
 #include "vga.h"
+#include "sync.h"
+#include "work.h"
 
 // Keyboard buffer
 static key_event_t key_buffer[KEYBOARD_BUFFER_SIZE];
@@ -9,6 +11,19 @@ static int buffer_start = 0;
 static int buffer_end = 0;
 static int buffer_count = 0;
 
+// Run while keyboard_get_key waits
+static keyboard_idle_fn idle_handler = NULL;
+
+// Scancodes the IRQ handler has read, waiting for keyboard_work; the
+// handler only writes head and the work only writes tail
+#define SCANCODE_RING 64
+static volatile uint8_t scancodes[SCANCODE_RING];
+static volatile uint32_t scancode_head = 0;
+static volatile uint32_t scancode_tail = 0;
+
+static void keyboard_work_fn(void* data);
+static work_t keyboard_work = WORK_INIT(WORK_KEYBOARD, keyboard_work_fn, NULL);
+
 // Key state
 static bool shift_held = false;
 static bool ctrl_held = false;
@@ -111,7 +126,7 @@ char keyboard_wait_char_poll(void) {
     }
 }
 
-// Common scancode processing, used by IRQ and polling fallback
+// Common scancode processing, run by keyboard_work for IRQ and polled scancodes
 static void keyboard_handle_scancode(uint8_t scancode) {
     bool released = (scancode & KEY_RELEASED) != 0;
     uint8_t key = scancode & 0x7F;
@@ -151,9 +166,33 @@ static void keyboard_handle_scancode(uint8_t scancode) {
     }
 }
 
+// Bottom half: turn the queued scancodes into key events
+static void keyboard_work_fn(void* data) {
+    (void)data;
+    while (scancode_tail != scancode_head) {
+        uint8_t scancode = scancodes[scancode_tail % SCANCODE_RING];
+        scancode_tail++;
+
+        // Key events are also taken off with interrupts off
+        uint32_t flags = irq_save();
+        keyboard_handle_scancode(scancode);
+        irq_restore(flags);
+    }
+}
+
+// Top half: read the scancode so the controller can send the next one,
+// and leave the rest to keyboard_work
+static void keyboard_queue_scancode(uint8_t scancode) {
+    if (scancode_head - scancode_tail < SCANCODE_RING) {
+        scancodes[scancode_head % SCANCODE_RING] = scancode;
+        scancode_head++;
+    }
+    work_queue(&keyboard_work);
+}
+
 static void keyboard_handler(registers_t* regs) {
     (void)regs;
-    keyboard_handle_scancode(inb(0x60));
+    keyboard_queue_scancode(inb(0x60));
 }
 
 void keyboard_init(void) {
@@ -166,9 +205,11 @@ void keyboard_init(void) {
     }
     
     // Enable keyboard interrupts
-    uint8_t mask = inb(0x21);
-    mask &= ~0x02;  // Clear bit 1 to enable IRQ1
-    outb(0x21, mask);
+    irq_unmask(1);
+}
+
+void keyboard_set_idle_handler(keyboard_idle_fn fn) {
+    idle_handler = fn;
 }
 
 bool keyboard_has_key(void) {
@@ -181,27 +222,38 @@ key_event_t keyboard_get_key(void) {
         // Poll as a fallback in case IRQ1 is masked by firmware/host
         uint8_t status = inb(0x64);
         if (status & 0x01) {
-            keyboard_handle_scancode(inb(0x60));
+            uint32_t flags = irq_save();
+            keyboard_queue_scancode(inb(0x60));
+            irq_restore(flags);
+            work_run();
             if (buffer_count > 0) break;
         }
+        if (idle_handler && idle_handler()) {
+            continue;  // More idle work; check for keys between steps
+        }
         hlt();  // Wait for interrupt
     }
     
+    uint32_t flags = irq_save();
     key_event_t event = key_buffer[buffer_start];
     buffer_start = (buffer_start + 1) % KEYBOARD_BUFFER_SIZE;
     buffer_count--;
+    irq_restore(flags);
     
     return event;
 }
 
 bool keyboard_try_get_key(key_event_t* event) {
+    uint32_t flags = irq_save();
     if (buffer_count == 0) {
+        irq_restore(flags);
         return false;
     }
     
     *event = key_buffer[buffer_start];
     buffer_start = (buffer_start + 1) % KEYBOARD_BUFFER_SIZE;
     buffer_count--;
+    irq_restore(flags);
     
     return true;
 }
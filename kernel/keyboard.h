@@ -55,9 +55,16 @@ typedef struct {
     bool released;
 } key_event_t;
 
+// Background work run while waiting for a key; returns true if there is
+// more to do, so the wait polls again instead of halting
+typedef bool (*keyboard_idle_fn)(void);
+
 // Initialize keyboard
 void keyboard_init(void);
 
+// Set the function run while blocked waiting for keys (NULL for none)
+void keyboard_set_idle_handler(keyboard_idle_fn fn);
+
 // Check if a key is available in buffer
 bool keyboard_has_key(void);
 
@@ -0,0 +1,209 @@
+#include "ktimer.h"
+#include "timer.h"
+#include "math64.h"
+#include "sync.h"
+#include "work.h"
+
+// A 256-slot root wheel holds timers due within 256 ticks, one slot per
+// tick. Each of four outer levels holds 64 slots, each slot 64 times as
+// long as a slot of the level below; as the root wheel wraps, the next
+// slot of level 0 is cascaded down into it, and so on outwards. Together
+// they cover 2^32 ticks; timers further off than that sit in the last
+// slot of level 3 and are placed again as it comes round.
+#define ROOT_BITS       8
+#define ROOT_SIZE       (1 << ROOT_BITS)
+#define ROOT_MASK       (ROOT_SIZE - 1)
+#define LEVEL_BITS      6
+#define LEVEL_SIZE      (1 << LEVEL_BITS)
+#define LEVEL_MASK      (LEVEL_SIZE - 1)
+#define LEVELS          4
+#define WHEEL_SPAN      (1ull << (ROOT_BITS + LEVELS * LEVEL_BITS))
+
+// Slot of a tick in one of the outer levels
+#define LEVEL_INDEX(tick, level) \
+    ((int)(((tick) >> (ROOT_BITS + (level) * LEVEL_BITS)) & LEVEL_MASK))
+
+static ktimer_t* root[ROOT_SIZE];
+static ktimer_t* levels[LEVELS][LEVEL_SIZE];
+
+// Next tick whose root slot hasn't been run
+static uint64_t wheel_tick = 0;
+
+static spinlock_t wheel_lock = SPINLOCK_INIT;
+static bool running = false;
+static ktimer_stats_t stats;
+
+static void run_timers(void* unused);
+static work_t timer_work = WORK_INIT(WORK_TIMER, run_timers, NULL);
+
+static void slot_link(ktimer_t** slot, ktimer_t* timer) {
+    timer->next = *slot;
+    if (timer->next) timer->next->pprev = &timer->next;
+    timer->pprev = slot;
+    *slot = timer;
+}
+
+static void slot_unlink(ktimer_t* timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) timer->next->pprev = timer->pprev;
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+// Put a timer in the slot for how far off it is; with wheel_lock held
+static void wheel_insert(ktimer_t* timer) {
+    uint64_t expires = timer->expires;
+    ktimer_t** slot;
+
+    if (expires < wheel_tick) {
+        // Already due (a periodic timer running late): the next slot run
+        slot = &root[wheel_tick & ROOT_MASK];
+    } else if (expires - wheel_tick < ROOT_SIZE) {
+        slot = &root[expires & ROOT_MASK];
+    } else {
+        if (expires - wheel_tick >= WHEEL_SPAN) {
+            expires = wheel_tick + WHEEL_SPAN - 1;
+        }
+        uint64_t delta = expires - wheel_tick;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= 1ull << (ROOT_BITS + (level + 1) * LEVEL_BITS)) {
+            level++;
+        }
+        slot = &levels[level][LEVEL_INDEX(expires, level)];
+    }
+    slot_link(slot, timer);
+}
+
+// Move every timer in a slot of an outer level to where it now belongs;
+// returns the slot index, which is 0 when the level wrapped too
+static int cascade(int level, int index) {
+    ktimer_t* list = levels[level][index];
+    levels[level][index] = NULL;
+
+    while (list) {
+        ktimer_t* timer = list;
+        list = timer->next;
+        wheel_insert(timer);
+        stats.cascaded++;
+    }
+    return index;
+}
+
+static uint64_t ms_to_ticks(uint32_t ms) {
+    uint32_t hz = timer_get_hz();
+    if (hz == 0) hz = TIMER_HZ;
+
+    // Round up, and never less than the next tick
+    uint64_t ticks = div_u64((uint64_t)ms * hz + 999, 1000);
+    return ticks ? ticks : 1;
+}
+
+void ktimer_init(ktimer_t* timer, ktimer_fn_t fn, void* data) {
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->period = 0;
+    timer->fn = fn;
+    timer->data = data;
+}
+
+static void start(ktimer_t* timer, uint64_t ticks, uint32_t period) {
+    uint32_t flags = spin_lock_irqsave(&wheel_lock);
+
+    if (timer->pprev) {
+        slot_unlink(timer);
+    } else {
+        // With nothing pending the wheel isn't advanced; catch it up
+        if (stats.pending == 0 && !running) wheel_tick = timer_ticks() + 1;
+        stats.pending++;
+    }
+    timer->expires = timer_ticks() + ticks;
+    timer->period = period;
+    wheel_insert(timer);
+
+    spin_unlock_irqrestore(&wheel_lock, flags);
+}
+
+void ktimer_start(ktimer_t* timer, uint32_t ms) {
+    start(timer, ms_to_ticks(ms), 0);
+}
+
+void ktimer_start_periodic(ktimer_t* timer, uint32_t period_ms) {
+    uint64_t ticks = ms_to_ticks(period_ms);
+    start(timer, ticks, ticks > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)ticks);
+}
+
+bool ktimer_cancel(ktimer_t* timer) {
+    uint32_t flags = spin_lock_irqsave(&wheel_lock);
+    bool was_pending = timer->pprev != NULL;
+
+    if (was_pending) {
+        slot_unlink(timer);
+        stats.pending--;
+    }
+
+    spin_unlock_irqrestore(&wheel_lock, flags);
+    return was_pending;
+}
+
+bool ktimer_pending(const ktimer_t* timer) {
+    return timer->pprev != NULL;
+}
+
+void ktimer_tick(void) {
+    if (stats.pending) work_queue(&timer_work);
+}
+
+// Run every root slot up to the current tick; deferred work, so with
+// interrupts enabled
+static void run_timers(void* unused) {
+    (void)unused;
+    uint32_t flags = spin_lock_irqsave(&wheel_lock);
+    running = true;
+
+    while (wheel_tick <= timer_ticks()) {
+        int index = (int)(wheel_tick & ROOT_MASK);
+        if (index == 0 &&
+            cascade(0, LEVEL_INDEX(wheel_tick, 0)) == 0 &&
+            cascade(1, LEVEL_INDEX(wheel_tick, 1)) == 0 &&
+            cascade(2, LEVEL_INDEX(wheel_tick, 2)) == 0) {
+            cascade(3, LEVEL_INDEX(wheel_tick, 3));
+        }
+
+        // Take the slot over, so a callback cancelling a timer still in
+        // it unlinks from here
+        ktimer_t* expired = root[index];
+        root[index] = NULL;
+        if (expired) expired->pprev = &expired;
+        wheel_tick++;
+
+        while (expired) {
+            ktimer_t* timer = expired;
+            slot_unlink(timer);
+            stats.pending--;
+            stats.fired++;
+
+            if (timer->period) {
+                timer->expires += timer->period;
+                wheel_insert(timer);
+                stats.pending++;
+            }
+
+            ktimer_fn_t fn = timer->fn;
+            void* data = timer->data;
+            spin_unlock_irqrestore(&wheel_lock, flags);
+            fn(data);
+            spin_lock_irqsave(&wheel_lock);
+        }
+    }
+
+    running = false;
+    spin_unlock_irqrestore(&wheel_lock, flags);
+}
+
+void ktimer_get_stats(ktimer_stats_t* out) {
+    if (out == NULL) return;
+    uint32_t flags = spin_lock_irqsave(&wheel_lock);
+    *out = stats;
+    spin_unlock_irqrestore(&wheel_lock, flags);
+}
@@ -0,0 +1,55 @@
+#ifndef KTIMER_H
+#define KTIMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Kernel timers on a hierarchical timing wheel driven by the system tick.
+// Starting and cancelling a timer are O(1). Callbacks don't run in the
+// tick's IRQ handler: they run as deferred work once the interrupt has
+// been acknowledged, with interrupts back on, so they may take locks,
+// start timers and do port I/O, but must not block.
+
+typedef void (*ktimer_fn_t)(void* data);
+
+typedef struct ktimer {
+    struct ktimer* next;      // Wheel slot links; pprev is NULL when idle
+    struct ktimer** pprev;
+    uint64_t expires;         // Tick the timer is due on
+    uint32_t period;          // Ticks between runs, 0 for one-shot
+    ktimer_fn_t fn;
+    void* data;
+} ktimer_t;
+
+// Timer wheel statistics
+typedef struct {
+    uint32_t pending;         // Timers waiting on the wheel
+    uint32_t fired;           // Callbacks run
+    uint32_t cascaded;        // Moves from an outer level to a finer one
+} ktimer_stats_t;
+
+// Set up a timer to call fn(data); it is not started
+void ktimer_init(ktimer_t* timer, ktimer_fn_t fn, void* data);
+
+// (Re)start a timer to run once, ms from now
+void ktimer_start(ktimer_t* timer, uint32_t ms);
+
+// (Re)start a timer to run every period_ms, the first time period_ms
+// from now; runs that fall behind are caught up, not dropped
+void ktimer_start_periodic(ktimer_t* timer, uint32_t period_ms);
+
+// Stop a timer; true if it was pending
+bool ktimer_cancel(ktimer_t* timer);
+
+// Whether a timer is waiting to run
+bool ktimer_pending(const ktimer_t* timer);
+
+// Note a system tick, queueing expired timers to run; called by the
+// tick's IRQ handler
+void ktimer_tick(void);
+
+// Get wheel statistics
+void ktimer_get_stats(ktimer_stats_t* stats);
+
+#endif // KTIMER_H
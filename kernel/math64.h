@@ -0,0 +1,38 @@
+#ifndef MATH64_H
+#define MATH64_H
+
+#include <stdint.h>
+
+// 64-bit arithmetic for a 32-bit kernel. GCC turns a 64-bit '/' or '%'
+// into calls to libgcc's __udivdi3/__umoddi3, which we don't link, so
+// divide through these instead.
+
+// Divide n by d, storing the remainder in *rem
+static inline uint64_t div_u64_rem(uint64_t n, uint32_t d, uint32_t* rem) {
+#if defined(__i386__)
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t lo = (uint32_t)n;
+    uint32_t q_hi = 0;
+
+    // Long division in two divl steps; the second can't overflow because
+    // what is left of hi is below d
+    if (hi >= d) {
+        q_hi = hi / d;
+        hi %= d;
+    }
+    __asm__ ("divl %4" : "=a"(lo), "=d"(hi) : "a"(lo), "d"(hi), "rm"(d));
+    *rem = hi;
+    return ((uint64_t)q_hi << 32) | lo;
+#else
+    *rem = (uint32_t)(n % d);
+    return n / d;
+#endif
+}
+
+// Divide n by d, discarding the remainder
+static inline uint64_t div_u64(uint64_t n, uint32_t d) {
+    uint32_t rem;
+    return div_u64_rem(n, d, &rem);
+}
+
+#endif // MATH64_H
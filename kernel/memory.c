@@ -1,40 +1,195 @@
 #include "memory.h"
 #include "string.h"
+#include "sync.h"
 
-// Heap management
+// Heap management. The heap is a list of regions; heap_start/heap_end
+// bound all of them and are only used for pointer sanity checks.
 static uint8_t* heap_start = NULL;
 static uint8_t* heap_end = NULL;
 static size_t heap_size = 0;
-static memory_block_t* free_list = NULL;
+
+// Each region starts with this descriptor and ends with an epilogue: a
+// zero-sized used block that stops physical walks at the region edge
+typedef struct memory_region {
+    struct memory_region* next;
+    uint8_t* end;             // One past the epilogue
+} memory_region_t;
+
+static memory_region_t* regions = NULL;
+static memory_region_t* last_region = NULL;
+
+// Called when no free block fits, to obtain more memory
+static memory_grow_fn grow_handler = NULL;
+
+// Serializes the heap proper. It is taken with interrupts off so IRQ
+// handlers can allocate too; the magazine fast path doesn't need it.
+static spinlock_t heap_lock = SPINLOCK_INIT;
 
 // Memory statistics
 static size_t total_allocs = 0;
 static size_t total_frees = 0;
 static size_t failed_allocs = 0;
 
+// Running totals, kept in step with every split, merge, alloc and free so
+// the stats calls never have to walk the heap. Epilogues aren't counted.
+static size_t free_bytes = 0;         // Payload bytes on the free lists
+static size_t free_block_count = 0;
+static size_t block_count = 0;
+static size_t region_count = 0;
+
+// Receives allocation events when tracing is on
+static memory_trace_fn trace_hook = NULL;
+
+// Allocation-site profiler: an open-addressed table keyed by caller. Each
+// used block is tagged with (generation << 16) | (slot + 1) so a free is
+// credited to the right site, and blocks from before a reset are ignored.
+static bool profiling = false;
+static memprof_site_t prof_sites[MEMPROF_MAX_SITES];
+static uint32_t prof_generation = 1;
+
+// Movable blocks are reached through this table; slot 0 is never used so
+// a block's handle field doubles as its movable flag. A handle is the slot
+// with the slot's sequence number above it, so stale handles are refused.
+typedef struct {
+    void* ptr;                // Payload address, NULL if the slot is unused
+    uint16_t seq;
+    uint16_t lock_count;
+} handle_entry_t;
+
+static handle_entry_t handle_table[MEMORY_MAX_HANDLES];
+static size_t movable_count = 0;
+
+// Magazine cache (Bonwick's magazine layer) in front of the heap. Small
+// blocks freed with kfree stay allocated and are parked in per-CPU
+// magazines, a loaded and a previous one per size class, which each CPU
+// works on with interrupts briefly off: no lock, and safe from IRQ
+// handlers. Full and empty magazines are traded with a depot under its
+// own lock; only when both run dry does a request reach the heap.
+#define MAG_SIZE       15             // Blocks per magazine
+#define MAG_CLASSES    10
+#define MAG_MAX_SIZE   512
+#define DEPOT_MAX_FULL 4              // Full magazines kept per class
+
+typedef struct magazine {
+    struct magazine* next;            // Depot list link
+    uint32_t count;
+    void* objs[MAG_SIZE];
+} magazine_t;
+
+typedef struct {
+    magazine_t* loaded;
+    magazine_t* previous;
+    uint32_t allocs;                  // Served without the heap
+    uint32_t frees;
+} mag_cpu_t;
+
+static const uint16_t mag_class_size[MAG_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512
+};
+
+// Class for a request, indexed by (size + 15) / 16
+static const uint8_t mag_class_of[MAG_MAX_SIZE / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+    8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9
+};
+
+static mag_cpu_t mag_cpu[MAX_CPUS][MAG_CLASSES];
+static magazine_t* depot_full[MAG_CLASSES];
+static uint32_t depot_full_count[MAG_CLASSES];
+static magazine_t* depot_empty = NULL;
+static spinlock_t depot_lock = SPINLOCK_INIT;
+
 // Alignment
 #define ALIGN_SIZE 8
 #define ALIGN(size) (((size) + (ALIGN_SIZE - 1)) & ~(ALIGN_SIZE - 1))
 #define BLOCK_SIZE ALIGN(sizeof(memory_block_t))
 #define MIN_BLOCK_SIZE 16
+#define REGION_SIZE ALIGN(sizeof(memory_region_t))
 
-void memory_init(void* start, size_t size) {
-    heap_start = (uint8_t*)start;
-    heap_size = size;
-    heap_end = heap_start + heap_size;
+// Free blocks smaller than this are cheap enough to clear in kcalloc and
+// aren't worth zeroing at idle time
+#define ZERO_MIN_BLOCK 256
+
+// Segregated free lists (two-level segregated fit). The first level splits
+// sizes into power-of-two ranges, the second level splits each range into
+// SL_COUNT linear sub-classes. Two bitmaps record which lists are non-empty
+// so finding a fitting class is a couple of bit scans instead of a heap walk.
+#define SL_SHIFT 2
+#define SL_COUNT (1 << SL_SHIFT)
+#define FL_COUNT 32
+
+// Requests from here up have no size class that is sure to fit them
+// (mapping_search's rounding would wrap), and could never be met anyway
+#define MAX_REQUEST ((size_t)1 << (FL_COUNT - 1))
+
+static memory_block_t* size_classes[FL_COUNT][SL_COUNT];
+static uint32_t fl_bitmap = 0;
+static uint8_t sl_bitmap[FL_COUNT];
+
+// Index of the most significant set bit
+static inline int fls_size(size_t size) {
+    return (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long)size);
+}
+
+// Size class a free block of this size is filed under
+static void mapping_insert(size_t size, int* fl, int* sl) {
+    int f = fls_size(size);
+    if (f >= FL_COUNT) {
+        *fl = FL_COUNT - 1;
+        *sl = SL_COUNT - 1;
+        return;
+    }
+    *fl = f;
+    *sl = (int)((size >> (f - SL_SHIFT)) ^ SL_COUNT);
+}
+
+// Smallest size class whose blocks are all large enough for the request
+static void mapping_search(size_t size, int* fl, int* sl) {
+    size_t round = ((size_t)1 << (fls_size(size) - SL_SHIFT)) - 1;
+    mapping_insert(size + round, fl, sl);
+}
+
+static void insert_free_block(memory_block_t* block) {
+    int fl, sl;
+    mapping_insert(block->size, &fl, &sl);
     
-    // Initialize statistics
-    total_allocs = 0;
-    total_frees = 0;
-    failed_allocs = 0;
+    memory_block_t* head = size_classes[fl][sl];
+    block->prev_free = NULL;
+    block->next_free = head;
+    if (head) {
+        head->prev_free = block;
+    }
+    size_classes[fl][sl] = block;
+    free_bytes += block->size;
+    free_block_count++;
     
-    // Initialize the free list with one big block
-    free_list = (memory_block_t*)heap_start;
-    free_list->magic = MEMORY_BLOCK_FREE_MAGIC;
-    free_list->size = heap_size - BLOCK_SIZE;
-    free_list->free = 1;
-    free_list->next = NULL;
-    free_list->prev = NULL;
+    fl_bitmap |= (1u << fl);
+    sl_bitmap[fl] |= (uint8_t)(1u << sl);
+}
+
+static void remove_free_block(memory_block_t* block) {
+    int fl, sl;
+    mapping_insert(block->size, &fl, &sl);
+    
+    if (block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    }
+    if (block->next_free) {
+        block->next_free->prev_free = block->prev_free;
+    }
+    if (size_classes[fl][sl] == block) {
+        size_classes[fl][sl] = block->next_free;
+        if (size_classes[fl][sl] == NULL) {
+            sl_bitmap[fl] &= (uint8_t)~(1u << sl);
+            if (sl_bitmap[fl] == 0) {
+                fl_bitmap &= ~(1u << fl);
+            }
+        }
+    }
+    block->next_free = NULL;
+    block->prev_free = NULL;
+    free_bytes -= block->size;
+    free_block_count--;
 }
 
 // Validate a block's magic number (with bounds checking)
@@ -49,50 +204,378 @@ static bool validate_block(memory_block_t* block) {
     }
     
     return (block->magic == MEMORY_BLOCK_MAGIC || 
-            block->magic == MEMORY_BLOCK_FREE_MAGIC);
+            block->magic == MEMORY_BLOCK_FREE_MAGIC ||
+            block->magic == MEMORY_BLOCK_CACHED_MAGIC);
+}
+
+// Header right after this block; the region epilogue for the last block
+static inline memory_block_t* phys_successor(memory_block_t* block) {
+    return (memory_block_t*)((uint8_t*)block + BLOCK_SIZE + block->size);
+}
+
+// Block physically following this one, or NULL at the end of its region
+static inline memory_block_t* next_phys(memory_block_t* block) {
+    memory_block_t* next = phys_successor(block);
+    if (next->size == 0) {
+        return NULL;  // Epilogue
+    }
+    return next;
+}
+
+static inline memory_block_t* region_first_block(memory_region_t* region) {
+    return (memory_block_t*)((uint8_t*)region + REGION_SIZE);
+}
+
+static inline memory_block_t* region_epilogue(memory_region_t* region) {
+    return (memory_block_t*)(region->end - BLOCK_SIZE);
+}
+
+// Block physically preceding this one; only valid when prev_phys_free is set
+static inline memory_block_t* prev_phys(memory_block_t* block) {
+    memory_footer_t* footer = (memory_footer_t*)((uint8_t*)block - sizeof(memory_footer_t));
+    return footer->header;
+}
+
+static inline void write_footer(memory_block_t* block) {
+    memory_footer_t* footer = (memory_footer_t*)((uint8_t*)block + BLOCK_SIZE +
+                                                 block->size - sizeof(memory_footer_t));
+    footer->header = block;
+}
+
+// Mark a block free or used and keep its successor's boundary flag in sync
+static void set_block_free(memory_block_t* block) {
+    block->free = 1;
+    block->magic = MEMORY_BLOCK_FREE_MAGIC;
+    write_footer(block);
+    phys_successor(block)->prev_phys_free = 1;
+}
+
+static void set_block_used(memory_block_t* block) {
+    block->free = 0;
+    block->magic = MEMORY_BLOCK_MAGIC;
+    phys_successor(block)->prev_phys_free = 0;
+}
+
+// Let lower absorb the free block physically above it. If upper is clean
+// the seam (lower's footer, upper's header) is wiped so the clean part of
+// upper isn't lost behind it.
+static void absorb_next(memory_block_t* lower, memory_block_t* upper) {
+    size_t size = lower->size + BLOCK_SIZE + upper->size;
+    
+    if (upper->dirty == 0 && lower->dirty < lower->size) {
+        memset((uint8_t*)upper - sizeof(memory_footer_t), 0, sizeof(memory_footer_t) + BLOCK_SIZE);
+    } else {
+        lower->dirty = lower->size + BLOCK_SIZE + upper->dirty;
+        upper->magic = 0;  // Stale header is now payload
+    }
+    lower->size = size;
+}
+
+// Merge a free block with its free physical neighbours. The block must not
+// be on a size-class list; neighbours are taken off theirs. Returns the
+// (possibly moved) start of the merged block.
+static memory_block_t* merge_free_neighbours(memory_block_t* block) {
+    memory_block_t* next = next_phys(block);
+    if (next && next->free) {
+        remove_free_block(next);
+        absorb_next(block, next);
+        block_count--;
+    }
+    
+    if (block->prev_phys_free) {
+        memory_block_t* prev = prev_phys(block);
+        if (!validate_block(prev) || !prev->free) {
+            set_block_free(block);  // Corrupt boundary tag, don't follow it
+            return block;
+        }
+        remove_free_block(prev);
+        absorb_next(prev, block);
+        block = prev;
+        block_count--;
+    }
+    
+    set_block_free(block);
+    return block;
+}
+
+static void write_epilogue(memory_block_t* epilogue, int prev_free) {
+    epilogue->magic = MEMORY_BLOCK_MAGIC;
+    epilogue->size = 0;
+    epilogue->free = 0;
+    epilogue->prev_phys_free = prev_free;
+    epilogue->dirty = 0;
+    epilogue->next_free = NULL;
+    epilogue->prev_free = NULL;
+}
+
+// Add a region; zeroed says its memory already reads as zero
+static bool add_region(void* start, size_t size, bool zeroed) {
+    uintptr_t base = ALIGN((uintptr_t)start);
+    if (base - (uintptr_t)start >= size) return false;
+    size = (size - (base - (uintptr_t)start)) & ~(size_t)(ALIGN_SIZE - 1);
+    uint8_t* p = (uint8_t*)base;
+    
+    // Memory directly after the last region just extends it: the old
+    // epilogue becomes the header of the new free block
+    if (last_region && p == last_region->end) {
+        if (size < BLOCK_SIZE + MIN_BLOCK_SIZE) return false;
+        
+        memory_block_t* block = region_epilogue(last_region);
+        int prev_free = block->prev_phys_free;
+        last_region->end += size;
+        write_epilogue(region_epilogue(last_region), 0);
+        
+        block->size = size - BLOCK_SIZE;
+        block->prev_phys_free = prev_free;
+        block->dirty = zeroed ? 0 : block->size;
+        block_count++;
+        block = merge_free_neighbours(block);
+        insert_free_block(block);
+    } else {
+        if (size < REGION_SIZE + 2 * BLOCK_SIZE + MIN_BLOCK_SIZE) return false;
+        
+        memory_region_t* region = (memory_region_t*)p;
+        region->next = NULL;
+        region->end = p + size;
+        if (last_region) {
+            last_region->next = region;
+        } else {
+            regions = region;
+        }
+        last_region = region;
+        
+        // One big free block covering the region, then the epilogue
+        memory_block_t* block = region_first_block(region);
+        block->size = size - REGION_SIZE - 2 * BLOCK_SIZE;
+        block->prev_phys_free = 0;
+        block->dirty = zeroed ? 0 : block->size;
+        write_epilogue(region_epilogue(region), 0);
+        set_block_free(block);
+        insert_free_block(block);
+        block_count++;
+        region_count++;
+    }
+    
+    if (heap_start == NULL || p < heap_start) heap_start = p;
+    if (p + size > heap_end) heap_end = p + size;
+    heap_size += size;
+    return true;
+}
+
+void memory_init(void* start, size_t size) {
+    heap_start = NULL;
+    heap_end = NULL;
+    heap_size = 0;
+    regions = NULL;
+    last_region = NULL;
+    
+    // Initialize statistics
+    total_allocs = 0;
+    total_frees = 0;
+    failed_allocs = 0;
+    free_bytes = 0;
+    free_block_count = 0;
+    block_count = 0;
+    region_count = 0;
+    
+    // Reset the size classes
+    memset(size_classes, 0, sizeof(size_classes));
+    memset(sl_bitmap, 0, sizeof(sl_bitmap));
+    fl_bitmap = 0;
+    
+    memset(handle_table, 0, sizeof(handle_table));
+    movable_count = 0;
+    
+    // Parked blocks belonged to the old heap
+    memset(mag_cpu, 0, sizeof(mag_cpu));
+    memset(depot_full, 0, sizeof(depot_full));
+    memset(depot_full_count, 0, sizeof(depot_full_count));
+    depot_empty = NULL;
+    
+    add_region(start, size, true);
+}
+
+bool memory_add_region(void* start, size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    bool added = add_region(start, size, false);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return added;
 }
 
-// Find a free block of at least the requested size (first fit)
+void memory_set_grow_handler(memory_grow_fn fn) {
+    grow_handler = fn;
+}
+
+// Ask the grow handler for a region that can satisfy a request
+static bool memory_grow(size_t size) {
+    if (grow_handler == NULL) return false;
+    
+    size_t got = 0;
+    void* mem = grow_handler(size + REGION_SIZE + 2 * BLOCK_SIZE, &got);
+    if (mem == NULL) return false;
+    
+    return add_region(mem, got, true);
+}
+
+// Find a free block of at least the requested size (segregated fit)
 static memory_block_t* find_free_block(size_t size) {
-    memory_block_t* current = free_list;
+    int fl, sl;
     
-    while (current != NULL) {
-        if (!validate_block(current)) {
-            // Memory corruption detected
+    // The head of the request's own class often fits and wastes least
+    mapping_insert(size, &fl, &sl);
+    memory_block_t* block = size_classes[fl][sl];
+    if (block && block->size >= size) {
+        return validate_block(block) ? block : NULL;
+    }
+    
+    // Otherwise take any block from the next class that is guaranteed to fit
+    mapping_search(size, &fl, &sl);
+    
+    uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        uint32_t fl_map = (fl + 1 < FL_COUNT) ? (fl_bitmap & (~0u << (fl + 1))) : 0;
+        if (fl_map == 0) {
             return NULL;
         }
-        if (current->free && current->size >= size) {
-            return current;
-        }
-        current = current->next;
+        fl = __builtin_ctz(fl_map);
+        sl_map = sl_bitmap[fl];
     }
+    sl = __builtin_ctz(sl_map);
     
-    return NULL;
+    block = size_classes[fl][sl];
+    if (!validate_block(block) || !block->free) {
+        // Memory corruption detected
+        return NULL;
+    }
+    return block;
 }
 
-// Split a block if it's too large
+// Split a block if it's too large; the tail becomes a free block
 static void split_block(memory_block_t* block, size_t size) {
     if (block->size >= size + BLOCK_SIZE + MIN_BLOCK_SIZE) {
         memory_block_t* new_block = (memory_block_t*)((uint8_t*)block + BLOCK_SIZE + size);
-        new_block->magic = MEMORY_BLOCK_FREE_MAGIC;
         new_block->size = block->size - size - BLOCK_SIZE;
-        new_block->free = 1;
-        new_block->next = block->next;
-        new_block->prev = block;
+        new_block->prev_phys_free = block->free;
+        new_block->dirty = block->dirty > size + BLOCK_SIZE ? block->dirty - size - BLOCK_SIZE : 0;
+        block->size = size;
+        if (block->dirty > size) block->dirty = size;
+        block_count++;
+        
+        // The tail may now touch a free block (e.g. when shrinking in krealloc)
+        new_block = merge_free_neighbours(new_block);
+        insert_free_block(new_block);
+    }
+}
+
+static inline void trace_event(char op, void* ptr, void* old_ptr, size_t size, size_t align) {
+    if (trace_hook) {
+        memory_trace_event_t event = { op, ptr, old_ptr, size, align };
+        trace_hook(&event);
+    }
+}
+
+void memory_set_trace_hook(memory_trace_fn fn) {
+    trace_hook = fn;
+}
+
+// Record an allocation against its call site and return the block tag
+static uint32_t memprof_charge(void* caller, size_t size) {
+    uint32_t hash = ((uint32_t)(uintptr_t)caller >> 2) * 2654435761u;
+    
+    for (uint32_t probe = 0; probe < MEMPROF_MAX_SITES; probe++) {
+        uint32_t slot = ((hash >> 16) + probe) % MEMPROF_MAX_SITES;
+        memprof_site_t* site = &prof_sites[slot];
         
-        if (block->next) {
-            block->next->prev = new_block;
+        if (site->caller == NULL) {
+            site->caller = caller;
+        } else if (site->caller != caller) {
+            continue;
         }
         
-        block->size = size;
-        block->next = new_block;
+        site->live_bytes += size;
+        site->live_count++;
+        site->alloc_count++;
+        if (site->live_bytes > site->peak_bytes) {
+            site->peak_bytes = site->live_bytes;
+        }
+        return (prof_generation << 16) | (slot + 1);
     }
+    
+    return 0;  // Table full; the block goes untracked
 }
 
-void* kmalloc(size_t size) {
+// Site a block was charged to, or NULL if it isn't tracked
+static memprof_site_t* memprof_site(memory_block_t* block) {
+    uint32_t tag = block->site;
+    uint32_t slot = (tag & 0xFFFF) - 1;
+    
+    if (tag == 0 || (tag >> 16) != prof_generation || slot >= MEMPROF_MAX_SITES) {
+        return NULL;
+    }
+    return &prof_sites[slot];
+}
+
+// Block size changed in place from old_size
+static void memprof_resize(memory_block_t* block, size_t old_size) {
+    memprof_site_t* site = memprof_site(block);
+    if (site == NULL) return;
+    
+    site->live_bytes = site->live_bytes - old_size + block->size;
+    if (site->live_bytes > site->peak_bytes) {
+        site->peak_bytes = site->live_bytes;
+    }
+}
+
+static void memprof_release(memory_block_t* block) {
+    memprof_site_t* site = memprof_site(block);
+    if (site == NULL) return;
+    
+    site->live_bytes -= block->size;
+    site->live_count--;
+}
+
+// Give the front of a free block (already off its list) back to the free
+// lists so that the payload starts on an align boundary. The block must
+// have room for the gap; returns the aligned block.
+static memory_block_t* align_block(memory_block_t* block, size_t align) {
+    uintptr_t payload = (uintptr_t)block + BLOCK_SIZE;
+    if ((payload & (align - 1)) == 0) {
+        return block;
+    }
+    
+    // The gap has to be big enough to stand as a free block of its own
+    uintptr_t aligned = (payload + BLOCK_SIZE + MIN_BLOCK_SIZE + align - 1) &
+                        ~(uintptr_t)(align - 1);
+    size_t gap = aligned - payload;
+    
+    memory_block_t* aligned_block = (memory_block_t*)(aligned - BLOCK_SIZE);
+    aligned_block->size = block->size - gap;
+    aligned_block->prev_phys_free = 1;
+    aligned_block->dirty = block->dirty > gap ? block->dirty - gap : 0;
+    
+    block->size = gap - BLOCK_SIZE;
+    if (block->dirty > block->size) block->dirty = block->size;
+    set_block_free(block);
+    insert_free_block(block);
+    block_count++;
+    
+    return aligned_block;
+}
+
+// Defined with the compactor and the magazine cache below
+static size_t compact_heap(void);
+static size_t mag_reclaim(void);
+
+// Allocate a block; with zero set the payload is cleared, which only
+// takes clearing the block's dirty prefix. Called with heap_lock held.
+static void* heap_alloc(size_t size, size_t align, void* caller, bool zero) {
     if (size == 0) {
         return NULL;
     }
+    if (size >= MAX_REQUEST) {
+        failed_allocs++;
+        return NULL;
+    }
     
     // Align the requested size
     size = ALIGN(size);
@@ -100,46 +583,109 @@ void* kmalloc(size_t size) {
         size = MIN_BLOCK_SIZE;
     }
     
-    memory_block_t* block = find_free_block(size);
+    // Over-aligned requests need room to slide the start up
+    size_t search = size;
+    if (align > ALIGN_SIZE) {
+        if (size > (size_t)-1 - align - BLOCK_SIZE - MIN_BLOCK_SIZE) {
+            failed_allocs++;
+            return NULL;
+        }
+        search = size + align + BLOCK_SIZE + MIN_BLOCK_SIZE;
+    }
+    if (search >= MAX_REQUEST) {
+        failed_allocs++;
+        return NULL;
+    }
+    
+    memory_block_t* block = find_free_block(search);
+    
+    // Blocks parked in magazines may be what is in the way
+    if (block == NULL && mag_reclaim() > 0) {
+        block = find_free_block(search);
+    }
+    
+    // Enough memory may be free but scattered; sliding movable blocks
+    // together is cheaper than growing the heap
+    if (block == NULL && free_bytes >= search && compact_heap() > 0) {
+        block = find_free_block(search);
+    }
+    
+    if (block == NULL && memory_grow(search)) {
+        block = find_free_block(search);
+    }
     
     if (block == NULL) {
         failed_allocs++;
         return NULL;  // Out of memory
     }
     
+    remove_free_block(block);
+    if (align > ALIGN_SIZE) {
+        block = align_block(block, align);
+    }
+    set_block_used(block);  // Mark as allocated
     split_block(block, size);
-    block->free = 0;
-    block->magic = MEMORY_BLOCK_MAGIC;  // Mark as allocated
+    block->site = profiling ? memprof_charge(caller, block->size) : 0;
+    block->handle = 0;
+    
+    uint8_t* ptr = (uint8_t*)block + BLOCK_SIZE;
+    if (zero) {
+        memset(ptr, 0, block->dirty < size ? block->dirty : size);
+        if (block->dirty < block->size) {
+            // A clean block still has its old footer at the end
+            memset(ptr + block->size - sizeof(memory_footer_t), 0, sizeof(memory_footer_t));
+        }
+    }
+    block->dirty = block->size;  // Used blocks count as dirty throughout
     
     total_allocs++;
     
-    return (void*)((uint8_t*)block + BLOCK_SIZE);
+    return ptr;
 }
 
-void* kcalloc(size_t count, size_t size) {
-    // Check for overflow
-    if (count != 0 && size > (size_t)-1 / count) {
-        failed_allocs++;
-        return NULL;
+static void heap_free(void* ptr) {
+    if (ptr == NULL) {
+        return;
     }
     
-    size_t total = count * size;
-    void* ptr = kmalloc(total);
+    // Validate the pointer is within heap bounds
+    if (!memory_is_valid_ptr(ptr)) {
+        return;  // Invalid pointer
+    }
     
-    if (ptr != NULL) {
-        memset(ptr, 0, total);
+    memory_block_t* block = (memory_block_t*)((uint8_t*)ptr - BLOCK_SIZE);
+    
+    // Validate block magic
+    if (!validate_block(block)) {
+        return;  // Memory corruption or invalid pointer
     }
     
-    return ptr;
+    if (block->magic != MEMORY_BLOCK_MAGIC) {
+        return;  // Double free protection (free or parked in a magazine)
+    }
+    
+    memprof_release(block);
+    
+    if (block->handle) {
+        handle_table[block->handle].ptr = NULL;
+        handle_table[block->handle].lock_count = 0;
+        movable_count--;
+    }
+    
+    // Coalesce with the physical neighbours only, then file by size
+    block->dirty = block->size;
+    block = merge_free_neighbours(block);
+    insert_free_block(block);
+    total_frees++;
 }
 
-void* krealloc(void* ptr, size_t size) {
+static void* heap_realloc(void* ptr, size_t size, void* caller) {
     if (ptr == NULL) {
-        return kmalloc(size);
+        return heap_alloc(size, ALIGN_SIZE, caller, false);
     }
     
     if (size == 0) {
-        kfree(ptr);
+        heap_free(ptr);
         return NULL;
     }
     
@@ -150,110 +696,347 @@ void* krealloc(void* ptr, size_t size) {
     
     memory_block_t* block = (memory_block_t*)((uint8_t*)ptr - BLOCK_SIZE);
     
-    if (!validate_block(block) || block->free) {
+    if (!validate_block(block) || block->magic != MEMORY_BLOCK_MAGIC) {
         return NULL;  // Invalid or already freed
     }
     
+    if (size >= MAX_REQUEST) {
+        failed_allocs++;
+        return NULL;
+    }
     size = ALIGN(size);
+    if (size < MIN_BLOCK_SIZE) {
+        size = MIN_BLOCK_SIZE;
+    }
+    size_t old_size = block->size;
     
     if (block->size >= size) {
         // Current block is big enough, potentially split it
         if (block->size > size + BLOCK_SIZE + MIN_BLOCK_SIZE) {
             split_block(block, size);
+            memprof_resize(block, old_size);
         }
         return ptr;
     }
     
     // Try to expand into next block if it's free
-    if (block->next && block->next->free && 
-        block->size + BLOCK_SIZE + block->next->size >= size) {
+    memory_block_t* next = next_phys(block);
+    if (next && next->free && 
+        block->size + BLOCK_SIZE + next->size >= size) {
         // Merge with next block
-        block->size += BLOCK_SIZE + block->next->size;
-        block->next = block->next->next;
-        if (block->next) {
-            block->next->prev = block;
-        }
+        remove_free_block(next);
+        block->size += BLOCK_SIZE + next->size;
+        next->magic = 0;
+        block_count--;
+        block->dirty = block->size;
+        set_block_used(block);
         // Potentially split if too large
         if (block->size > size + BLOCK_SIZE + MIN_BLOCK_SIZE) {
             split_block(block, size);
         }
+        memprof_resize(block, old_size);
         return ptr;
     }
     
-    // Need to allocate a new block
-    void* new_ptr = kmalloc(size);
+    // Need to allocate a new block; a movable block takes its handle along
+    // and is pinned meanwhile so compaction can't move it from under us
+    uint32_t handle = block->handle;
+    if (handle) handle_table[handle].lock_count++;
+    void* new_ptr = heap_alloc(size, ALIGN_SIZE, caller, false);
+    if (handle) handle_table[handle].lock_count--;
+    
     if (new_ptr != NULL) {
         memcpy(new_ptr, ptr, block->size);
-        kfree(ptr);
+        if (handle) {
+            memory_block_t* new_block = (memory_block_t*)((uint8_t*)new_ptr - BLOCK_SIZE);
+            new_block->handle = handle;
+            handle_table[handle].ptr = new_ptr;
+            block->handle = 0;
+        }
+        heap_free(ptr);
     }
     
     return new_ptr;
 }
 
-// Merge adjacent free blocks
-static void coalesce_blocks(void) {
-    memory_block_t* current = free_list;
+static void* locked_alloc(size_t size, size_t align, void* caller, bool zero) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void* ptr = heap_alloc(size, align, caller, zero);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+// Get a parked block of class k for this CPU, or NULL
+static void* mag_alloc(int k) {
+    void* ptr = NULL;
+    uint32_t flags = irq_save();
+    mag_cpu_t* cpu = &mag_cpu[cpu_id()][k];
     
-    while (current != NULL && current->next != NULL) {
-        if (!validate_block(current)) {
-            break;  // Memory corruption
-        }
-        
-        if (current->free && current->next->free) {
-            // Merge current with next
-            current->size += BLOCK_SIZE + current->next->size;
-            current->next = current->next->next;
-            if (current->next) {
-                current->next->prev = current;
-            }
-            // Don't advance, try to merge again
+    if (cpu->loaded == NULL || cpu->loaded->count == 0) {
+        if (cpu->previous && cpu->previous->count > 0) {
+            magazine_t* m = cpu->loaded;
+            cpu->loaded = cpu->previous;
+            cpu->previous = m;
         } else {
-            current = current->next;
+            // Trade an empty magazine for a full one from the depot
+            spin_lock(&depot_lock);
+            magazine_t* full = depot_full[k];
+            if (full) {
+                depot_full[k] = full->next;
+                depot_full_count[k]--;
+                if (cpu->previous) {
+                    cpu->previous->next = depot_empty;
+                    depot_empty = cpu->previous;
+                }
+                cpu->previous = cpu->loaded;
+                cpu->loaded = full;
+            }
+            spin_unlock(&depot_lock);
         }
     }
+    
+    if (cpu->loaded && cpu->loaded->count > 0) {
+        ptr = cpu->loaded->objs[--cpu->loaded->count];
+        ((memory_block_t*)((uint8_t*)ptr - BLOCK_SIZE))->magic = MEMORY_BLOCK_MAGIC;
+        cpu->allocs++;
+    }
+    irq_restore(flags);
+    return ptr;
 }
 
-void kfree(void* ptr) {
-    if (ptr == NULL) {
-        return;
+// Park a block in this CPU's class k magazine; false if there is no room
+// short of a new empty magazine
+static bool mag_free(memory_block_t* block, int k) {
+    bool parked = false;
+    uint32_t flags = irq_save();
+    mag_cpu_t* cpu = &mag_cpu[cpu_id()][k];
+    
+    if (cpu->loaded == NULL || cpu->loaded->count == MAG_SIZE) {
+        if (cpu->previous && cpu->previous->count < MAG_SIZE) {
+            magazine_t* m = cpu->loaded;
+            cpu->loaded = cpu->previous;
+            cpu->previous = m;
+        } else {
+            // Trade the full previous magazine for an empty one
+            spin_lock(&depot_lock);
+            magazine_t* empty = depot_empty;
+            if (empty && depot_full_count[k] < DEPOT_MAX_FULL) {
+                depot_empty = empty->next;
+                empty->count = 0;
+                if (cpu->previous) {
+                    cpu->previous->next = depot_full[k];
+                    depot_full[k] = cpu->previous;
+                    depot_full_count[k]++;
+                }
+                cpu->previous = cpu->loaded;
+                cpu->loaded = empty;
+            }
+            spin_unlock(&depot_lock);
+        }
     }
     
-    // Validate the pointer is within heap bounds
-    if (!memory_is_valid_ptr(ptr)) {
-        return;  // Invalid pointer
+    if (cpu->loaded && cpu->loaded->count < MAG_SIZE) {
+        block->magic = MEMORY_BLOCK_CACHED_MAGIC;
+        block->site = 0;  // Freed as far as the profiler is concerned
+        cpu->loaded->objs[cpu->loaded->count++] = (uint8_t*)block + BLOCK_SIZE;
+        cpu->frees++;
+        parked = true;
     }
+    irq_restore(flags);
+    return parked;
+}
+
+// Give the depot another empty magazine, unless class k has all the full
+// ones it may keep
+static bool mag_add_empty(int k) {
+    if (depot_full_count[k] >= DEPOT_MAX_FULL) return false;
     
-    memory_block_t* block = (memory_block_t*)((uint8_t*)ptr - BLOCK_SIZE);
+    magazine_t* m = locked_alloc(sizeof(magazine_t), ALIGN_SIZE, NULL, false);
+    if (m == NULL) return false;
     
-    // Validate block magic
-    if (!validate_block(block)) {
-        return;  // Memory corruption or invalid pointer
+    uint32_t flags = spin_lock_irqsave(&depot_lock);
+    m->next = depot_empty;
+    depot_empty = m;
+    spin_unlock_irqrestore(&depot_lock, flags);
+    return true;
+}
+
+// Class a block can be parked under: the largest class it holds, as long
+// as it is no bigger than heap_alloc would make a block of that class
+static int mag_class_for_block(memory_block_t* block) {
+    size_t size = block->size;
+    
+    if (size < MIN_BLOCK_SIZE || size >= MAG_MAX_SIZE + BLOCK_SIZE + MIN_BLOCK_SIZE) {
+        return -1;
+    }
+    int k = size >= MAG_MAX_SIZE ? MAG_CLASSES - 1 : mag_class_of[(size + 15) / 16];
+    if (mag_class_size[k] > size) k--;
+    return size < mag_class_size[k] + BLOCK_SIZE + MIN_BLOCK_SIZE ? k : -1;
+}
+
+static void mag_release(magazine_t* m) {
+    while (m->count > 0) {
+        memory_block_t* block = (memory_block_t*)((uint8_t*)m->objs[--m->count] - BLOCK_SIZE);
+        block->magic = MEMORY_BLOCK_MAGIC;
+        heap_free((uint8_t*)block + BLOCK_SIZE);
+        total_frees--;  // Already counted when it was parked
     }
+    heap_free(m);
+}
+
+// Return every parked block and every magazine to the heap; called with
+// heap_lock held. With one CPU, interrupts being off is what makes it safe
+// to empty the per-CPU magazines from here.
+static size_t mag_reclaim(void) {
+    size_t before = free_bytes;
     
-    if (block->free) {
-        return;  // Double free protection
+    for (int c = 0; c < MAX_CPUS; c++) {
+        for (int k = 0; k < MAG_CLASSES; k++) {
+            mag_cpu_t* cpu = &mag_cpu[c][k];
+            if (cpu->loaded) mag_release(cpu->loaded);
+            if (cpu->previous) mag_release(cpu->previous);
+            cpu->loaded = NULL;
+            cpu->previous = NULL;
+        }
     }
     
-    block->free = 1;
-    block->magic = MEMORY_BLOCK_FREE_MAGIC;  // Mark as free
-    total_frees++;
+    spin_lock(&depot_lock);
+    for (int k = 0; k < MAG_CLASSES; k++) {
+        while (depot_full[k]) {
+            magazine_t* m = depot_full[k];
+            depot_full[k] = m->next;
+            mag_release(m);
+        }
+        depot_full_count[k] = 0;
+    }
+    while (depot_empty) {
+        magazine_t* m = depot_empty;
+        depot_empty = m->next;
+        heap_free(m);
+    }
+    spin_unlock(&depot_lock);
     
-    coalesce_blocks();
+    return free_bytes - before;
 }
 
-size_t memory_get_free(void) {
-    size_t free_size = 0;
-    memory_block_t* current = free_list;
+// kmalloc and kcalloc: small requests are rounded up to a magazine class
+// and served from the magazines when they have a block
+static void* cached_alloc(size_t size, void* caller, bool zero) {
+    if (size == 0 || size > MAG_MAX_SIZE || profiling) {
+        return locked_alloc(size, ALIGN_SIZE, caller, zero);
+    }
     
-    while (current != NULL) {
-        if (!validate_block(current)) break;
-        if (current->free) {
-            free_size += current->size;
+    int k = mag_class_of[(size + 15) / 16];
+    void* ptr = mag_alloc(k);
+    if (ptr == NULL) {
+        return locked_alloc(mag_class_size[k], ALIGN_SIZE, caller, zero);
+    }
+    if (zero) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+void* kmalloc(size_t size) {
+    void* ptr = cached_alloc(size, __builtin_return_address(0), false);
+    trace_event('m', ptr, NULL, size, ALIGN_SIZE);
+    return ptr;
+}
+
+void* kmalloc_aligned(size_t size, size_t align) {
+    if (align == 0 || (align & (align - 1)) != 0) {
+        return NULL;  // Not a power of two
+    }
+    void* ptr = locked_alloc(size, align, __builtin_return_address(0), false);
+    trace_event('m', ptr, NULL, size, align);
+    return ptr;
+}
+
+void* kcalloc(size_t count, size_t size) {
+    // Check for overflow
+    if (count != 0 && size > (size_t)-1 / count) {
+        failed_allocs++;
+        return NULL;
+    }
+    
+    size_t total = count * size;
+    void* ptr = cached_alloc(total, __builtin_return_address(0), true);
+    trace_event('m', ptr, NULL, total, ALIGN_SIZE);
+    return ptr;
+}
+
+void* krealloc(void* ptr, size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void* new_ptr = heap_realloc(ptr, size, __builtin_return_address(0));
+    spin_unlock_irqrestore(&heap_lock, flags);
+    trace_event('r', new_ptr, ptr, size, ALIGN_SIZE);
+    return new_ptr;
+}
+
+void kfree(void* ptr) {
+    trace_event('f', ptr, NULL, 0, 0);
+    if (ptr == NULL) {
+        return;
+    }
+    
+    // Small blocks go to the magazines; the block is ours until then, so
+    // its header can be read without the heap lock
+    if (!profiling && memory_is_valid_ptr(ptr)) {
+        memory_block_t* block = (memory_block_t*)((uint8_t*)ptr - BLOCK_SIZE);
+        int k = mag_class_for_block(block);
+        if (k >= 0 && block->magic == MEMORY_BLOCK_MAGIC && block->handle == 0 &&
+            (mag_free(block, k) || (mag_add_empty(k) && mag_free(block, k)))) {
+            return;
         }
-        current = current->next;
     }
     
-    return free_size;
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    heap_free(ptr);
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+// Dirty free block worth zeroing ahead of time, largest classes first
+static memory_block_t* find_dirty_block(void) {
+    int min_fl, min_sl;
+    mapping_insert(ZERO_MIN_BLOCK, &min_fl, &min_sl);
+    
+    for (int fl = FL_COUNT - 1; fl >= min_fl; fl--) {
+        if (!(fl_bitmap & (1u << fl))) continue;
+        for (int sl = SL_COUNT - 1; sl >= 0; sl--) {
+            for (memory_block_t* b = size_classes[fl][sl]; b; b = b->next_free) {
+                if (b->dirty > 0) return b;
+            }
+        }
+    }
+    return NULL;
+}
+
+static bool zero_idle(size_t budget) {
+    while (budget > 0) {
+        memory_block_t* block = find_dirty_block();
+        if (block == NULL) return false;
+        
+        // Clear from the end of the dirty prefix so it just shrinks; the
+        // footer is left alone
+        size_t end = block->size - sizeof(memory_footer_t);
+        if (block->dirty > end) block->dirty = end;
+        size_t chunk = block->dirty < budget ? block->dirty : budget;
+        block->dirty -= chunk;
+        memset((uint8_t*)block + BLOCK_SIZE + block->dirty, 0, chunk);
+        budget -= chunk;
+    }
+    return true;
+}
+
+bool memory_zero_idle(size_t budget) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    bool more = zero_idle(budget);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return more;
+}
+
+size_t memory_get_free(void) {
+    return free_bytes;
 }
 
 size_t memory_get_total(void) {
@@ -261,70 +1044,94 @@ size_t memory_get_total(void) {
 }
 
 size_t memory_get_used(void) {
-    return heap_size - memory_get_free();
+    return heap_size - free_bytes;
 }
 
-size_t memory_get_largest_free(void) {
+static size_t largest_free_block(void) {
+    if (fl_bitmap == 0) return 0;
+    
+    // The highest non-empty size class holds the largest block; only
+    // that one list needs scanning
+    int fl = 31 - __builtin_clz(fl_bitmap);
+    int sl = 31 - __builtin_clz((uint32_t)sl_bitmap[fl]);
+    
     size_t largest = 0;
-    memory_block_t* current = free_list;
+    for (memory_block_t* b = size_classes[fl][sl]; b; b = b->next_free) {
+        if (b->size > largest) {
+            largest = b->size;
+        }
+    }
+    return largest;
+}
+
+size_t memory_get_largest_free(void) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    size_t largest = largest_free_block();
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return largest;
+}
+
+// Bytes parked in magazines, and how many allocations and frees they took
+static size_t mag_totals(size_t* allocs, size_t* frees) {
+    size_t bytes = 0;
     
-    while (current != NULL) {
-        if (!validate_block(current)) break;
-        if (current->free && current->size > largest) {
-            largest = current->size;
+    *allocs = 0;
+    *frees = 0;
+    for (int c = 0; c < MAX_CPUS; c++) {
+        for (int k = 0; k < MAG_CLASSES; k++) {
+            mag_cpu_t* cpu = &mag_cpu[c][k];
+            if (cpu->loaded) bytes += cpu->loaded->count * mag_class_size[k];
+            if (cpu->previous) bytes += cpu->previous->count * mag_class_size[k];
+            *allocs += cpu->allocs;
+            *frees += cpu->frees;
         }
-        current = current->next;
     }
     
-    return largest;
+    spin_lock(&depot_lock);
+    for (int k = 0; k < MAG_CLASSES; k++) {
+        for (magazine_t* m = depot_full[k]; m; m = m->next) {
+            bytes += m->count * mag_class_size[k];
+        }
+    }
+    spin_unlock(&depot_lock);
+    return bytes;
 }
 
 void memory_get_stats(memory_stats_t* stats) {
     if (stats == NULL) return;
     
+    size_t cached_allocs, cached_frees;
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    stats->cached_size = mag_totals(&cached_allocs, &cached_frees);
     stats->total_size = heap_size;
-    stats->free_size = 0;
-    stats->used_size = 0;
-    stats->largest_free = 0;
-    stats->block_count = 0;
-    stats->free_block_count = 0;
-    stats->alloc_count = total_allocs;
-    stats->free_count = total_frees;
+    stats->free_size = free_bytes;
+    stats->used_size = heap_size - free_bytes - block_count * BLOCK_SIZE -
+                       region_count * (REGION_SIZE + BLOCK_SIZE);
+    stats->largest_free = largest_free_block();
+    stats->block_count = block_count;
+    stats->free_block_count = free_block_count;
+    stats->alloc_count = total_allocs + cached_allocs;
+    stats->free_count = total_frees + cached_frees;
     stats->failed_allocs = failed_allocs;
-    
-    memory_block_t* current = free_list;
-    
-    while (current != NULL) {
-        if (!validate_block(current)) break;
-        
-        stats->block_count++;
-        
-        if (current->free) {
-            stats->free_size += current->size;
-            stats->free_block_count++;
-            if (current->size > stats->largest_free) {
-                stats->largest_free = current->size;
-            }
-        } else {
-            stats->used_size += current->size;
-        }
-        
-        current = current->next;
-    }
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
 
-bool memory_validate(void) {
-    memory_block_t* current = free_list;
+// Walk one region checking block headers and boundary tags
+static bool memory_validate_region(memory_region_t* region, size_t* blocks) {
+    memory_block_t* current = region_first_block(region);
+    bool prev_free = false;
     
     while (current != NULL) {
+        (*blocks)++;
+        
         // Check magic number
         if (!validate_block(current)) {
             return false;  // Corruption detected
         }
         
         // Check bounds
-        if ((uint8_t*)current < heap_start || 
-            (uint8_t*)current >= heap_end) {
+        if ((uint8_t*)current < (uint8_t*)region || 
+            (uint8_t*)current + BLOCK_SIZE + current->size > region->end - BLOCK_SIZE) {
             return false;
         }
         
@@ -333,24 +1140,252 @@ bool memory_validate(void) {
             return false;
         }
         
-        // Check linked list consistency
-        if (current->next && current->next->prev != current) {
+        // Check boundary tags: the flag must mirror the predecessor, free
+        // neighbours must have been merged, and a free predecessor's
+        // footer must point back at it
+        if ((current->prev_phys_free != 0) != prev_free) {
+            return false;
+        }
+        if (current->free && (prev_free || current->dirty > current->size)) {
             return false;
         }
+        if (current->free) {
+            memory_footer_t* footer = (memory_footer_t*)((uint8_t*)current + BLOCK_SIZE +
+                                                         current->size - sizeof(memory_footer_t));
+            if (footer->header != current) {
+                return false;
+            }
+        }
+        prev_free = current->free != 0;
         
-        current = current->next;
+        // A movable block must be where its handle says it is
+        if (!current->free && current->handle &&
+            (current->handle >= MEMORY_MAX_HANDLES ||
+             handle_table[current->handle].ptr != (uint8_t*)current + BLOCK_SIZE)) {
+            return false;
+        }
+        
+        current = next_phys(current);
     }
     
-    return true;
+    // The epilogue closes the region and mirrors the last block
+    memory_block_t* epilogue = region_epilogue(region);
+    return epilogue->magic == MEMORY_BLOCK_MAGIC && epilogue->size == 0 &&
+           (epilogue->prev_phys_free != 0) == prev_free;
+}
+
+static bool validate_heap(void) {
+    size_t blocks = 0, regions_seen = 0;
+    size_t listed_bytes = 0, listed_blocks = 0;
+    
+    for (memory_region_t* r = regions; r; r = r->next) {
+        if (!memory_validate_region(r, &blocks)) {
+            return false;
+        }
+        regions_seen++;
+    }
+    
+    // Every block on a size-class list must be free and filed correctly
+    for (int fl = 0; fl < FL_COUNT; fl++) {
+        for (int sl = 0; sl < SL_COUNT; sl++) {
+            bool listed = (sl_bitmap[fl] & (1u << sl)) != 0;
+            if (listed != (size_classes[fl][sl] != NULL)) {
+                return false;
+            }
+            for (memory_block_t* b = size_classes[fl][sl]; b; b = b->next_free) {
+                int bfl, bsl;
+                if (!validate_block(b) || !b->free) {
+                    return false;
+                }
+                mapping_insert(b->size, &bfl, &bsl);
+                if (bfl != fl || bsl != sl) {
+                    return false;
+                }
+                listed_bytes += b->size;
+                listed_blocks++;
+            }
+        }
+    }
+    
+    // Parked blocks must still be marked as parked
+    for (int c = 0; c < MAX_CPUS; c++) {
+        for (int k = 0; k < MAG_CLASSES; k++) {
+            magazine_t* mags[2] = { mag_cpu[c][k].loaded, mag_cpu[c][k].previous };
+            for (int i = 0; i < 2; i++) {
+                for (uint32_t j = 0; mags[i] && j < mags[i]->count; j++) {
+                    memory_block_t* b = (memory_block_t*)((uint8_t*)mags[i]->objs[j] - BLOCK_SIZE);
+                    if (!validate_block(b) || b->magic != MEMORY_BLOCK_CACHED_MAGIC) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    
+    // The running totals must agree with what is actually there
+    return blocks == block_count && regions_seen == region_count &&
+           listed_bytes == free_bytes && listed_blocks == free_block_count;
+}
+
+bool memory_validate(void) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    bool valid = validate_heap();
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return valid;
 }
 
 void memory_defragment(void) {
-    // First pass: coalesce adjacent free blocks
-    coalesce_blocks();
+    // Adjacent free blocks are already merged by kfree via the boundary
+    // tags; only movable blocks can be shifted to join what remains.
+    memory_compact();
+}
+
+// Move a movable block down into the free block right before it. The
+// free space ends up after the block, merged with whatever follows.
+// Returns the new free block.
+static memory_block_t* slide_block_down(memory_block_t* hole, memory_block_t* block) {
+    size_t hole_size = hole->size;
+    
+    remove_free_block(hole);
+    memmove(hole, block, BLOCK_SIZE + block->size);
+    
+    memory_block_t* moved = hole;
+    moved->prev_phys_free = 0;  // Free blocks never touch, so this was used
+    handle_table[moved->handle].ptr = (uint8_t*)moved + BLOCK_SIZE;
+    trace_event('v', (uint8_t*)moved + BLOCK_SIZE, (uint8_t*)block + BLOCK_SIZE, moved->size, 0);
+    
+    memory_block_t* gap = phys_successor(moved);
+    gap->size = hole_size;
+    gap->prev_phys_free = 0;
+    gap->dirty = hole_size;
+    gap = merge_free_neighbours(gap);
+    insert_free_block(gap);
+    return gap;
+}
+
+static size_t compact_heap(void) {
+    size_t moved = 0;
+    
+    if (movable_count == 0) return 0;
+    
+    for (memory_region_t* r = regions; r; r = r->next) {
+        memory_block_t* current = region_first_block(r);
+        
+        while (current != NULL) {
+            memory_block_t* next = next_phys(current);
+            
+            if (current->free && next && !next->free && next->handle &&
+                handle_table[next->handle].lock_count == 0) {
+                current = slide_block_down(current, next);
+                moved++;
+                continue;
+            }
+            current = next;
+        }
+    }
+    
+    return moved;
+}
+
+size_t memory_compact(void) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    size_t moved = compact_heap();
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return moved;
+}
+
+// Table entry for a live handle, or NULL
+static handle_entry_t* handle_entry(handle_t handle) {
+    uint32_t slot = handle & 0xFFFF;
+    
+    if (slot == 0 || slot >= MEMORY_MAX_HANDLES) return NULL;
+    
+    handle_entry_t* entry = &handle_table[slot];
+    if (entry->ptr == NULL || entry->seq != (handle >> 16)) return NULL;
+    return entry;
+}
+
+static handle_t heap_hmalloc(size_t size, void* caller) {
+    uint32_t slot = 1;
+    while (slot < MEMORY_MAX_HANDLES && handle_table[slot].ptr != NULL) {
+        slot++;
+    }
+    if (slot == MEMORY_MAX_HANDLES) {
+        failed_allocs++;
+        return 0;
+    }
+    
+    void* ptr = heap_alloc(size, ALIGN_SIZE, caller, false);
+    trace_event('m', ptr, NULL, size, ALIGN_SIZE);
+    if (ptr == NULL) return 0;
+    
+    memory_block_t* block = (memory_block_t*)((uint8_t*)ptr - BLOCK_SIZE);
+    block->handle = slot;
+    movable_count++;
+    
+    handle_entry_t* entry = &handle_table[slot];
+    entry->ptr = ptr;
+    entry->lock_count = 0;
+    entry->seq++;
+    if (entry->seq == 0) entry->seq = 1;
+    
+    return ((handle_t)entry->seq << 16) | slot;
+}
+
+handle_t hmalloc(size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    handle_t handle = heap_hmalloc(size, __builtin_return_address(0));
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return handle;
+}
+
+void* hlock(handle_t handle) {
+    void* ptr = NULL;
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    handle_entry_t* entry = handle_entry(handle);
+    if (entry) {
+        entry->lock_count++;
+        ptr = entry->ptr;
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+void hunlock(handle_t handle) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    handle_entry_t* entry = handle_entry(handle);
+    if (entry && entry->lock_count > 0) {
+        entry->lock_count--;
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+bool hrealloc(handle_t handle, size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    handle_entry_t* entry = handle_entry(handle);
+    void* old_ptr = NULL;
+    void* new_ptr = NULL;
+    
+    // heap_realloc moves the handle along with the data
+    if (entry && entry->lock_count == 0 && size > 0) {
+        old_ptr = entry->ptr;
+        new_ptr = heap_realloc(old_ptr, size, __builtin_return_address(0));
+        trace_event('r', new_ptr, old_ptr, size, ALIGN_SIZE);
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return new_ptr != NULL;
+}
+
+void hfree(handle_t handle) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    handle_entry_t* entry = handle_entry(handle);
     
-    // Note: Full defragmentation (moving allocated blocks) is not
-    // implemented as it would require updating all pointers, which
-    // is not feasible without a garbage collector or memory handles.
+    // A pinned block may still be in use through the pointer hlock gave out
+    if (entry && entry->lock_count == 0) {
+        trace_event('f', entry->ptr, NULL, 0, 0);
+        heap_free(entry->ptr);
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
 
 bool memory_is_valid_ptr(void* ptr) {
@@ -381,3 +1416,169 @@ void memory_dump(void) {
     // This function would typically output to console
     // For now, it's a placeholder for debugging
 }
+
+void memory_profile_enable(bool enable) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    profiling = enable;
+    
+    // Parked blocks would be handed out uncharged; return them first
+    if (enable) {
+        mag_reclaim();
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+bool memory_profile_enabled(void) {
+    return profiling;
+}
+
+void memory_profile_reset(void) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    memset(prof_sites, 0, sizeof(prof_sites));
+    
+    // Old tags stop matching; skip 0 so untracked blocks never match
+    prof_generation = (prof_generation + 1) & 0xFFFF;
+    if (prof_generation == 0) {
+        prof_generation = 1;
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+int memory_profile_top(memprof_site_t* out, int max) {
+    int count = 0;
+    
+    if (out == NULL || max <= 0) return 0;
+    
+    // Insertion sort into out, dropping whatever falls off the end
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    for (int i = 0; i < MEMPROF_MAX_SITES; i++) {
+        memprof_site_t* site = &prof_sites[i];
+        if (site->caller == NULL) continue;
+        
+        int pos = count;
+        while (pos > 0 && (out[pos - 1].live_bytes < site->live_bytes ||
+               (out[pos - 1].live_bytes == site->live_bytes &&
+                out[pos - 1].peak_bytes < site->peak_bytes))) {
+            pos--;
+        }
+        if (pos >= max) continue;
+        
+        int last = count < max ? count : max - 1;
+        for (int j = last; j > pos; j--) {
+            out[j] = out[j - 1];
+        }
+        out[pos] = *site;
+        if (count < max) count++;
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+    
+    return count;
+}
+
+// Arena allocator
+
+#define ARENA_CHUNK_HDR ALIGN(sizeof(arena_chunk_t))
+
+static arena_chunk_t* arena_new_chunk(size_t size) {
+    arena_chunk_t* chunk = (arena_chunk_t*)kmalloc(ARENA_CHUNK_HDR + size);
+    if (chunk == NULL) return NULL;
+    
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+arena_t* arena_create(size_t chunk_size) {
+    if (chunk_size == 0) return NULL;
+    
+    arena_t* arena = (arena_t*)kmalloc(sizeof(arena_t));
+    if (arena == NULL) return NULL;
+    
+    arena->chunk_size = ALIGN(chunk_size);
+    arena->first = arena_new_chunk(arena->chunk_size);
+    if (arena->first == NULL) {
+        kfree(arena);
+        return NULL;
+    }
+    arena->chunks = arena->first;
+    arena->chunk_count = 1;
+    arena->bytes_used = 0;
+    return arena;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    if (arena == NULL || size == 0) return NULL;
+    
+    size = ALIGN(size);
+    arena_chunk_t* chunk = arena->chunks;
+    
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        if (size > arena->chunk_size / 2) {
+            // Large request: give it its own chunk behind the current one
+            // so the space left in the current chunk isn't abandoned
+            arena_chunk_t* big = arena_new_chunk(size);
+            if (big == NULL) return NULL;
+            if (chunk) {
+                big->next = chunk->next;
+                chunk->next = big;
+            } else {
+                arena->chunks = big;
+            }
+            arena->chunk_count++;
+            arena->bytes_used += size;
+            big->used = size;
+            return (uint8_t*)big + ARENA_CHUNK_HDR;
+        }
+        
+        chunk = arena_new_chunk(arena->chunk_size);
+        if (chunk == NULL) return NULL;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->chunk_count++;
+    }
+    
+    void* ptr = (uint8_t*)chunk + ARENA_CHUNK_HDR + chunk->used;
+    chunk->used += size;
+    arena->bytes_used += size;
+    return ptr;
+}
+
+void* arena_calloc(arena_t* arena, size_t size) {
+    void* ptr = arena_alloc(arena, size);
+    if (ptr != NULL) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+void arena_reset(arena_t* arena) {
+    if (arena == NULL) return;
+    
+    arena_chunk_t* chunk = arena->chunks;
+    while (chunk != NULL) {
+        arena_chunk_t* next = chunk->next;
+        if (chunk != arena->first) {
+            kfree(chunk);
+        }
+        chunk = next;
+    }
+    
+    arena->first->next = NULL;
+    arena->first->used = 0;
+    arena->chunks = arena->first;
+    arena->chunk_count = 1;
+    arena->bytes_used = 0;
+}
+
+void arena_destroy(arena_t* arena) {
+    if (arena == NULL) return;
+    
+    arena_chunk_t* chunk = arena->chunks;
+    while (chunk != NULL) {
+        arena_chunk_t* next = chunk->next;
+        kfree(chunk);
+        chunk = next;
+    }
+    kfree(arena);
+}
@@ -8,15 +8,35 @@
 // Memory block header with magic number for validation
 #define MEMORY_BLOCK_MAGIC 0xDEADBEEF
 #define MEMORY_BLOCK_FREE_MAGIC 0xFEEDFACE
+#define MEMORY_BLOCK_CACHED_MAGIC 0xCAC4EDB1  // Freed, parked in a magazine
 
+// Blocks are laid out back to back; the physical successor is found from
+// the size, the predecessor from the boundary tag (footer) at the end of
+// every free block, which only exists while prev_phys_free is set.
+// Past its first dirty bytes a free block's payload reads as zero, all
+// but the footer, so kcalloc only has to clear the dirty part.
 typedef struct memory_block {
     uint32_t magic;           // Magic number for block validation
     size_t size;
-    int free;
-    struct memory_block* next;
-    struct memory_block* prev; // Double-linked list for better coalescing
+    uint8_t free;
+    uint8_t prev_phys_free;   // Physically preceding block is free
+    uint16_t reserved;
+    size_t dirty;             // Payload bytes that may be non-zero
+    union {
+        struct memory_block* next_free; // Size-class free list (free blocks only)
+        uint32_t handle;      // Handle table slot of a movable block, or 0
+    };
+    union {
+        struct memory_block* prev_free;
+        uint32_t site;        // Profiler tag (used blocks only)
+    };
 } memory_block_t;
 
+// Boundary tag written into the last bytes of a free block's payload
+typedef struct {
+    memory_block_t* header;
+} memory_footer_t;
+
 // Memory statistics structure
 typedef struct {
     size_t total_size;        // Total heap size
@@ -28,14 +48,57 @@ typedef struct {
     size_t alloc_count;       // Total allocations made
     size_t free_count;        // Total frees made
     size_t failed_allocs;     // Failed allocation attempts
+    size_t cached_size;       // Freed small blocks parked for reuse (in used_size)
 } memory_stats_t;
 
-// Initialize memory manager
+// Allocation-site profile entry
+#define MEMPROF_MAX_SITES 128
+
+typedef struct {
+    void* caller;             // Return address of the allocating call
+    size_t live_bytes;        // Bytes currently allocated from this site
+    size_t peak_bytes;        // High-water mark of live_bytes
+    uint32_t live_count;      // Blocks currently allocated
+    uint32_t alloc_count;     // Allocations since profiling was reset
+} memprof_site_t;
+
+// Movable allocation, reached through the handle table. 0 is never valid.
+typedef uint32_t handle_t;
+
+#define MEMORY_MAX_HANDLES 64
+
+// Heap event passed to the trace hook
+typedef struct {
+    char op;                  // 'm' alloc, 'r' realloc, 'f' free, 'v' moved
+    void* ptr;                // Resulting block (the freed one for 'f')
+    void* old_ptr;            // Previous address for 'r' and 'v'
+    size_t size;
+    size_t align;
+} memory_trace_event_t;
+
+typedef void (*memory_trace_fn)(const memory_trace_event_t* event);
+
+// Callback used to grow the heap: returns at least min_size bytes of new,
+// zero-filled memory and stores the actual size in *size, or NULL if none
+// is left. The kernel's heap pages are zeroed when first touched.
+typedef void* (*memory_grow_fn)(size_t min_size, size_t* size);
+
+// Initialize memory manager on zero-filled memory
 void memory_init(void* heap_start, size_t heap_size);
 
+// Add another region of memory (any contents) to the heap
+bool memory_add_region(void* start, size_t size);
+
+// Set the callback kmalloc uses when no free block fits
+void memory_set_grow_handler(memory_grow_fn fn);
+
 // Allocate memory
 void* kmalloc(size_t size);
 
+// Allocate memory whose address is a multiple of align (a power of two).
+// Heap memory is only virtually contiguous; use dma_alloc for devices.
+void* kmalloc_aligned(size_t size, size_t align);
+
 // Allocate zeroed memory
 void* kcalloc(size_t count, size_t size);
 
@@ -45,6 +108,14 @@ void* krealloc(void* ptr, size_t size);
 // Free memory
 void kfree(void* ptr);
 
+// Zero up to budget bytes of dirty free memory ahead of kcalloc; returns
+// true while there is more to do. Meant for idle time.
+bool memory_zero_idle(size_t budget);
+
+// Report every allocation, resize, free and compaction move to fn (NULL
+// turns tracing off); fn must not allocate
+void memory_set_trace_hook(memory_trace_fn fn);
+
 // Get free memory size
 size_t memory_get_free(void);
 
@@ -63,9 +134,27 @@ void memory_get_stats(memory_stats_t* stats);
 // Validate memory integrity
 bool memory_validate(void);
 
-// Defragment memory (merge adjacent free blocks)
+// Defragment memory (compacts movable blocks)
 void memory_defragment(void);
 
+// Slide unlocked movable blocks down over free space; returns blocks moved
+size_t memory_compact(void);
+
+// Allocate movable memory
+handle_t hmalloc(size_t size);
+
+// Pin a movable block and get its address; NULL for a bad handle
+void* hlock(handle_t handle);
+
+// Drop a pin taken by hlock
+void hunlock(handle_t handle);
+
+// Resize an unlocked movable block
+bool hrealloc(handle_t handle, size_t size);
+
+// Free an unlocked movable block; a handle still locked is left alone
+void hfree(handle_t handle);
+
 // Check if pointer is valid heap pointer
 bool memory_is_valid_ptr(void* ptr);
 
@@ -75,4 +164,47 @@ size_t memory_get_block_size(void* ptr);
 // Debug: dump memory map
 void memory_dump(void);
 
+// Turn allocation-site profiling on or off
+void memory_profile_enable(bool enable);
+
+// Check whether allocation-site profiling is on
+bool memory_profile_enabled(void);
+
+// Forget all recorded sites; blocks allocated before are no longer tracked
+void memory_profile_reset(void);
+
+// Copy up to max sites into out, largest live_bytes first; returns the count
+int memory_profile_top(memprof_site_t* out, int max);
+
+// Bump-pointer arena for allocations that share one lifetime. Memory is
+// carved from chained kmalloc'd chunks and only released all at once.
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    size_t size;              // Usable bytes after the header
+    size_t used;
+} arena_chunk_t;
+
+typedef struct arena {
+    arena_chunk_t* chunks;    // Chunk being filled first
+    arena_chunk_t* first;     // Chunk kept across arena_reset
+    size_t chunk_size;
+    size_t chunk_count;
+    size_t bytes_used;        // Bytes handed out since the last reset
+} arena_t;
+
+// Create an arena that grows in chunks of chunk_size bytes
+arena_t* arena_create(size_t chunk_size);
+
+// Allocate from an arena (8-byte aligned, not zeroed)
+void* arena_alloc(arena_t* arena, size_t size);
+
+// Allocate zeroed memory from an arena
+void* arena_calloc(arena_t* arena, size_t size);
+
+// Release everything allocated from an arena, keeping its first chunk
+void arena_reset(arena_t* arena);
+
+// Free an arena and all of its chunks
+void arena_destroy(arena_t* arena);
+
 #endif // MEMORY_H
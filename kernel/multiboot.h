@@ -0,0 +1,49 @@
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include <stdint.h>
+
+// Multiboot (version 1) information passed by the bootloader in EBX
+
+// Flags in multiboot_info_t.flags saying which fields are valid
+#define MULTIBOOT_INFO_MEMORY   (1 << 0)   // mem_lower/mem_upper
+#define MULTIBOOT_INFO_MODS     (1 << 3)   // mods_count/mods_addr
+#define MULTIBOOT_INFO_MEM_MAP  (1 << 6)   // mmap_length/mmap_addr
+
+// Memory map entry types
+#define MULTIBOOT_MEMORY_AVAILABLE        1
+#define MULTIBOOT_MEMORY_RESERVED         2
+#define MULTIBOOT_MEMORY_ACPI_RECLAIMABLE 3
+#define MULTIBOOT_MEMORY_NVS              4
+#define MULTIBOOT_MEMORY_BADRAM           5
+
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;       // KB of memory below 1 MB
+    uint32_t mem_upper;       // KB of memory above 1 MB
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;     // Size of the memory map in bytes
+    uint32_t mmap_addr;       // Physical address of the first entry
+} __attribute__((packed)) multiboot_info_t;
+
+// The size field does not count itself; the next entry is at
+// (uint8_t*)entry + entry->size + sizeof(entry->size)
+typedef struct {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+typedef struct {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t string;
+    uint32_t reserved;
+} __attribute__((packed)) multiboot_module_t;
+
+#endif // MULTIBOOT_H
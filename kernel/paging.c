@@ -0,0 +1,191 @@
+#include "paging.h"
+#include "pmm.h"
+#include "cpu.h"
+#include "idt.h"
+#include "vga.h"
+#include "string.h"
+#include "kernel.h"
+
+// Kernel page directory; page tables come from the page allocator and
+// are reached through the identity map
+static uint32_t page_directory[1024] __attribute__((aligned(PAGE_SIZE)));
+
+static bool paging_enabled = false;
+static bool use_pse = false;
+static uint32_t identity_end = 0;
+
+// Heap window state
+static uint32_t heap_start = HEAP_VIRT_BASE + PAGE_SIZE;  // Low guard page below
+static uint32_t heap_brk = HEAP_VIRT_BASE + PAGE_SIZE;
+static uint32_t heap_resident = 0;
+static uint32_t heap_faults = 0;
+
+// Provided by the linker / boot.asm
+extern uint32_t _kernel_end;
+extern uint8_t stack_guard[];
+
+#define PDE_INDEX(v)   ((v) >> 22)
+#define PTE_INDEX(v)   (((v) >> 12) & 0x3FF)
+#define FRAME(e)       ((e) & ~0xFFFu)
+#define LARGE_PAGE     0x400000u
+
+// Page table for a virtual address, created on demand
+static uint32_t* get_page_table(uint32_t virt, bool create) {
+    uint32_t* pde = &page_directory[PDE_INDEX(virt)];
+
+    if (*pde & PTE_PRESENT) {
+        if (*pde & PTE_LARGE) return NULL;
+        return (uint32_t*)FRAME(*pde);
+    }
+    if (!create) return NULL;
+
+    uint32_t* table = (uint32_t*)alloc_zeroed_page();
+    if (table == NULL) return NULL;
+
+    *pde = (uint32_t)table | PTE_PRESENT | PTE_WRITE;
+    return table;
+}
+
+bool paging_map_page(uint32_t virt, uint32_t phys, uint32_t flags) {
+    uint32_t* table = get_page_table(virt, true);
+    if (table == NULL) return false;
+
+    table[PTE_INDEX(virt)] = FRAME(phys) | (flags & 0xFFF) | PTE_PRESENT;
+    if (paging_enabled) {
+        invlpg((void*)virt);
+    }
+    return true;
+}
+
+uint32_t paging_unmap_page(uint32_t virt) {
+    uint32_t* table = get_page_table(virt, false);
+    if (table == NULL) return 0;
+
+    uint32_t entry = table[PTE_INDEX(virt)];
+    table[PTE_INDEX(virt)] = 0;
+    if (paging_enabled) {
+        invlpg((void*)virt);
+    }
+    return (entry & PTE_PRESENT) ? FRAME(entry) : 0;
+}
+
+uint32_t paging_virt_to_phys(uint32_t virt) {
+    uint32_t pde = page_directory[PDE_INDEX(virt)];
+    if (!(pde & PTE_PRESENT)) return 0;
+    if (pde & PTE_LARGE) {
+        return (pde & ~(LARGE_PAGE - 1)) | (virt & (LARGE_PAGE - 1));
+    }
+
+    uint32_t pte = ((uint32_t*)FRAME(pde))[PTE_INDEX(virt)];
+    if (!(pte & PTE_PRESENT)) return 0;
+    return FRAME(pte) | (virt & 0xFFF);
+}
+
+bool paging_identity_map(uint32_t phys, size_t size, uint32_t flags) {
+    uint32_t page = phys & ~0xFFFu;
+    uint32_t end = phys + size;
+
+    if (size == 0) return true;
+    if (end < phys) end = 0;    // Runs to the top of the address space
+
+    do {
+        if (paging_virt_to_phys(page) != page && !paging_map_page(page, page, flags)) {
+            return false;
+        }
+        page += PAGE_SIZE;
+    } while (page != 0 && (end == 0 || page < end));
+    return true;
+}
+
+// Back a heap page on first touch; anything else is a real fault
+static bool page_fault_handler(registers_t* regs) {
+    uint32_t addr = read_cr2();
+
+    if (!(regs->err_code & PTE_PRESENT) && addr >= heap_start && addr < heap_brk) {
+        void* frame = alloc_zeroed_page();
+        if (frame == NULL) {
+            kernel_panic("Out of memory backing a heap page!");
+        }
+
+        if (!paging_map_page(addr & ~0xFFFu, (uint32_t)frame, PTE_WRITE)) {
+            kernel_panic("Out of memory for a heap page table!");
+        }
+        heap_resident++;
+        heap_faults++;
+        return true;
+    }
+
+    if (addr >= (uint32_t)stack_guard && addr < (uint32_t)stack_guard + PAGE_SIZE) {
+        vga_puts("\n*** Kernel stack overflow (guard page) ***\n");
+    } else if (addr >= HEAP_VIRT_BASE && addr < HEAP_VIRT_BASE + HEAP_VIRT_SIZE) {
+        vga_puts("\n*** Heap guard page hit ***\n");
+    }
+    return false;
+}
+
+void paging_init(void) {
+    pmm_stats_t pstats;
+    pmm_get_stats(&pstats);
+
+    memset(page_directory, 0, sizeof(page_directory));
+    use_pse = (cpu_features_edx() & CPUID_EDX_PSE) != 0;
+
+    // Identity-map all of RAM the page allocator manages
+    identity_end = (pstats.highest_addr + LARGE_PAGE - 1) & ~(LARGE_PAGE - 1);
+    if (identity_end == 0 || identity_end > HEAP_VIRT_BASE) {
+        identity_end = HEAP_VIRT_BASE;
+    }
+
+    // The kernel image gets 4 KB pages so the stack guard can be unmapped;
+    // the rest of RAM uses 4 MB pages when the CPU has PSE
+    uint32_t small_end = ((uint32_t)&_kernel_end + LARGE_PAGE - 1) & ~(LARGE_PAGE - 1);
+
+    for (uint32_t addr = 0; addr < identity_end; addr += LARGE_PAGE) {
+        if (use_pse && addr >= small_end) {
+            page_directory[PDE_INDEX(addr)] = addr | PTE_PRESENT | PTE_WRITE | PTE_LARGE;
+            continue;
+        }
+        for (uint32_t page = addr; page < addr + LARGE_PAGE; page += PAGE_SIZE) {
+            if (!paging_map_page(page, page, PTE_WRITE)) {
+                kernel_panic("Out of memory building page tables!");
+            }
+        }
+    }
+
+    paging_unmap_page((uint32_t)stack_guard);
+
+    isr_register_handler(14, page_fault_handler);
+
+    write_cr3((uint32_t)page_directory);
+    if (use_pse) {
+        write_cr4(read_cr4() | CR4_PSE);
+    }
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+    paging_enabled = true;
+}
+
+void* paging_heap_grow(size_t min_size, size_t* size) {
+    size_t step = (min_size + KERNEL_HEAP_GROW - 1) & ~(size_t)(KERNEL_HEAP_GROW - 1);
+    uint32_t limit = HEAP_VIRT_BASE + HEAP_VIRT_SIZE - PAGE_SIZE;  // High guard page
+
+    if (step == 0 || step > limit - heap_brk) return NULL;
+
+    // Pages are only backed on touch, but don't promise more than exists
+    if (step > pmm_get_free()) return NULL;
+
+    void* start = (void*)heap_brk;
+    heap_brk += step;
+    *size = step;
+    return start;
+}
+
+void paging_get_stats(paging_stats_t* stats) {
+    if (stats == NULL) return;
+
+    stats->pse = use_pse;
+    stats->identity_end = identity_end;
+    stats->heap_start = heap_start;
+    stats->heap_brk = heap_brk;
+    stats->heap_resident = heap_resident;
+    stats->heap_faults = heap_faults;
+}
@@ -0,0 +1,55 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Page table entry flags
+#define PTE_PRESENT  0x001
+#define PTE_WRITE    0x002
+#define PTE_USER     0x004
+#define PTE_PWT      0x008
+#define PTE_PCD      0x010
+#define PTE_LARGE    0x080        // 4 MB page (page directory entries only)
+
+// Virtual window the kernel heap lives in. Pages inside the window are
+// backed by the page-fault handler on first touch; the first page and
+// everything past the current break stay unmapped as guards.
+#define HEAP_VIRT_BASE  0xD0000000
+#define HEAP_VIRT_SIZE  0x10000000  // 256 MB
+
+// Paging statistics
+typedef struct {
+    bool pse;                 // 4 MB pages in use for the identity map
+    uint32_t identity_end;    // End of the identity-mapped range
+    uint32_t heap_start;      // First usable heap address
+    uint32_t heap_brk;        // End of the reserved heap range
+    uint32_t heap_resident;   // Heap pages backed by physical memory
+    uint32_t heap_faults;     // Demand faults served
+} paging_stats_t;
+
+// Build the kernel page tables and enable paging
+void paging_init(void);
+
+// Map one 4 KB page
+bool paging_map_page(uint32_t virt, uint32_t phys, uint32_t flags);
+
+// Unmap one 4 KB page; returns the physical address it mapped, or 0
+uint32_t paging_unmap_page(uint32_t virt);
+
+// Identity-map the pages covering [phys, phys + size) that aren't mapped
+// yet, for firmware tables and device registers outside RAM; pass
+// PTE_PCD | PTE_PWT for registers
+bool paging_identity_map(uint32_t phys, size_t size, uint32_t flags);
+
+// Physical address behind a virtual one, or 0 if unmapped
+uint32_t paging_virt_to_phys(uint32_t virt);
+
+// Extend the heap break by at least min_size bytes (memory_grow_fn)
+void* paging_heap_grow(size_t min_size, size_t* size);
+
+// Get paging statistics
+void paging_get_stats(paging_stats_t* stats);
+
+#endif // PAGING_H
@@ -0,0 +1,347 @@
+#include "pmm.h"
+#include "string.h"
+#include "sync.h"
+
+// Per-page metadata, indexed by page frame number from physical 0
+static page_t* page_map = NULL;
+static uint32_t page_count = 0;
+
+// Free lists, one per block order
+static page_t* free_area[PMM_MAX_ORDER + 1];
+static uint32_t free_area_count[PMM_MAX_ORDER + 1];
+
+// Statistics
+static size_t total_pages = 0;
+static size_t free_page_count = 0;
+static uint32_t highest_addr = 0;
+
+// Pages zeroed ahead of time; counted as allocated
+static void* zero_pool[PMM_ZERO_POOL];
+static int zero_pool_count = 0;
+
+// Guards the free lists, counters and zero pool. Taken with interrupts
+// off: kmalloc from an IRQ handler can fault a heap page in, which
+// allocates here.
+static spinlock_t pmm_lock = SPINLOCK_INIT;
+
+// Usable ranges copied out of the memory map before page_map is written,
+// in case the bootloader left the map where page_map is about to go
+#define PMM_MAX_RANGES 32
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} pmm_range_t;
+
+static pmm_range_t usable[PMM_MAX_RANGES];
+static int usable_count = 0;
+
+// Low memory holds the BIOS data, VGA memory and option ROMs
+#define PMM_LOW_LIMIT     0x100000
+#define PMM_FALLBACK_SIZE 0x400000  // Used when the bootloader gave no map
+#define PMM_HIGH_LIMIT    0xC0000000ULL
+
+static inline uint32_t page_align_up(uint32_t addr) {
+    return (addr + PAGE_SIZE - 1) & ~(uint32_t)(PAGE_SIZE - 1);
+}
+
+static inline uint32_t page_align_down(uint32_t addr) {
+    return addr & ~(uint32_t)(PAGE_SIZE - 1);
+}
+
+static inline uint32_t page_pfn(page_t* page) {
+    return (uint32_t)(page - page_map);
+}
+
+static void free_area_add(page_t* page, unsigned int order) {
+    page->order = (uint8_t)order;
+    page->flags |= PAGE_FLAG_FREE;
+    page->prev = NULL;
+    page->next = free_area[order];
+    if (free_area[order]) {
+        free_area[order]->prev = page;
+    }
+    free_area[order] = page;
+    free_area_count[order]++;
+}
+
+static void free_area_del(page_t* page, unsigned int order) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        free_area[order] = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+    page->next = page->prev = NULL;
+    page->flags &= ~PAGE_FLAG_FREE;
+    free_area_count[order]--;
+}
+
+// Return a block to the free lists, merging it with free buddies
+static void free_block(uint32_t pfn, unsigned int order) {
+    free_page_count += (size_t)1 << order;
+
+    while (order < PMM_MAX_ORDER) {
+        uint32_t buddy = pfn ^ (1u << order);
+        if (buddy >= page_count) break;
+
+        page_t* bp = &page_map[buddy];
+        if (!(bp->flags & PAGE_FLAG_FREE) || bp->order != order) break;
+
+        free_area_del(bp, order);
+        pfn &= ~(1u << order);
+        order++;
+    }
+
+    free_area_add(&page_map[pfn], order);
+}
+
+static void add_usable(uint32_t start, uint32_t end) {
+    if (start < PMM_LOW_LIMIT) start = PMM_LOW_LIMIT;
+    start = page_align_up(start);
+    end = page_align_down(end);
+    if (end <= start || usable_count >= PMM_MAX_RANGES) return;
+
+    usable[usable_count].start = start;
+    usable[usable_count].end = end;
+    usable_count++;
+    if (end > highest_addr) {
+        highest_addr = end;
+    }
+}
+
+// Hand a range of pages to the allocator as maximal aligned blocks
+static void add_free_range(uint32_t start, uint32_t end) {
+    uint32_t pfn = start >> PAGE_SHIFT;
+    uint32_t end_pfn = end >> PAGE_SHIFT;
+
+    while (pfn < end_pfn) {
+        unsigned int order = PMM_MAX_ORDER;
+        while (order > 0 &&
+               ((pfn & ((1u << order) - 1)) || pfn + (1u << order) > end_pfn)) {
+            order--;
+        }
+
+        for (uint32_t i = 0; i < (1u << order); i++) {
+            page_map[pfn + i].flags = 0;
+        }
+        total_pages += (size_t)1 << order;
+        free_block(pfn, order);
+
+        pfn += 1u << order;
+    }
+}
+
+void pmm_init(multiboot_info_t* mbi, uint32_t reserved_end) {
+    memset(free_area, 0, sizeof(free_area));
+    memset(free_area_count, 0, sizeof(free_area_count));
+    total_pages = 0;
+    free_page_count = 0;
+    zero_pool_count = 0;
+    highest_addr = 0;
+    usable_count = 0;
+
+    if (mbi && (mbi->flags & MULTIBOOT_INFO_MEM_MAP)) {
+        uint8_t* entry = (uint8_t*)mbi->mmap_addr;
+        uint8_t* map_end = entry + mbi->mmap_length;
+
+        while (entry < map_end) {
+            multiboot_mmap_entry_t* e = (multiboot_mmap_entry_t*)entry;
+
+            // RAM is identity-mapped, so it has to stay below the
+            // kernel's virtual windows
+            if (e->type == MULTIBOOT_MEMORY_AVAILABLE && e->addr < PMM_HIGH_LIMIT) {
+                uint64_t end = e->addr + e->len;
+                if (end > PMM_HIGH_LIMIT) end = PMM_HIGH_LIMIT;
+                add_usable((uint32_t)e->addr, (uint32_t)end);
+            }
+
+            entry += e->size + sizeof(e->size);
+        }
+    } else if (mbi && (mbi->flags & MULTIBOOT_INFO_MEMORY)) {
+        add_usable(PMM_LOW_LIMIT, PMM_LOW_LIMIT + mbi->mem_upper * 1024);
+    } else {
+        add_usable(PMM_LOW_LIMIT, page_align_up(reserved_end) + PMM_FALLBACK_SIZE);
+    }
+
+    // Keep boot modules out of the allocator
+    if (mbi && (mbi->flags & MULTIBOOT_INFO_MODS)) {
+        multiboot_module_t* mods = (multiboot_module_t*)mbi->mods_addr;
+        for (uint32_t i = 0; i < mbi->mods_count; i++) {
+            if (mods[i].mod_end > reserved_end) {
+                reserved_end = mods[i].mod_end;
+            }
+        }
+    }
+
+    // The page map itself sits right after the kernel image
+    page_count = highest_addr >> PAGE_SHIFT;
+    page_map = (page_t*)page_align_up(reserved_end);
+    uint32_t first_free = page_align_up((uint32_t)page_map + page_count * sizeof(page_t));
+
+    memset(page_map, 0, page_count * sizeof(page_t));
+    for (uint32_t i = 0; i < page_count; i++) {
+        page_map[i].flags = PAGE_FLAG_RESERVED;
+    }
+
+    for (int i = 0; i < usable_count; i++) {
+        uint32_t start = usable[i].start;
+        if (start < first_free) start = first_free;
+        if (start < usable[i].end) {
+            add_free_range(start, usable[i].end);
+        }
+    }
+}
+
+// Take a free block of order o and cut it down to the requested order
+static void* take_block(page_t* page, unsigned int o, unsigned int order) {
+    free_area_del(page, o);
+    uint32_t pfn = page_pfn(page);
+
+    // Split the block down, returning the upper halves to the free lists
+    while (o > order) {
+        o--;
+        free_area_add(&page_map[pfn + (1u << o)], o);
+    }
+
+    page->order = (uint8_t)order;
+    free_page_count -= (size_t)1 << order;
+
+    return (void*)(pfn << PAGE_SHIFT);
+}
+
+// alloc_pages with pmm_lock held
+static void* alloc_locked(unsigned int order) {
+    unsigned int o = order;
+    while (o <= PMM_MAX_ORDER && free_area[o] == NULL) {
+        o++;
+    }
+    if (o > PMM_MAX_ORDER) {
+        // Out of memory: the zero pool is the last reserve for single pages
+        if (order == 0 && zero_pool_count > 0) {
+            return zero_pool[--zero_pool_count];
+        }
+        return NULL;
+    }
+
+    return take_block(free_area[o], o, order);
+}
+
+void* alloc_pages(unsigned int order) {
+    if (order > PMM_MAX_ORDER) return NULL;
+
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    void* block = alloc_locked(order);
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return block;
+}
+
+void* alloc_pages_below(unsigned int order, uint32_t limit) {
+    if (order > PMM_MAX_ORDER) return NULL;
+
+    uint32_t limit_pfn = limit >> PAGE_SHIFT;
+    void* block = NULL;
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+
+    // The allocation comes from the bottom of whichever block is split
+    for (unsigned int o = order; o <= PMM_MAX_ORDER && block == NULL; o++) {
+        for (page_t* page = free_area[o]; page; page = page->next) {
+            if (page_pfn(page) + (1u << order) <= limit_pfn) {
+                block = take_block(page, o, order);
+                break;
+            }
+        }
+    }
+
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return block;
+}
+
+void free_pages(void* addr, unsigned int order) {
+    uint32_t pfn = (uint32_t)addr >> PAGE_SHIFT;
+
+    if (addr == NULL || order > PMM_MAX_ORDER) return;
+    if (((uint32_t)addr & (PAGE_SIZE - 1)) || (pfn & ((1u << order) - 1))) return;
+    if (pfn + (1u << order) > page_count) return;
+
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    page_t* page = &page_map[pfn];
+    if (!(page->flags & (PAGE_FLAG_FREE | PAGE_FLAG_RESERVED))) {
+        free_block(pfn, order);
+    }
+    // Otherwise a double free or not ours
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+void* alloc_zeroed_page(void) {
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    if (zero_pool_count > 0) {
+        void* pooled = zero_pool[--zero_pool_count];
+        spin_unlock_irqrestore(&pmm_lock, flags);
+        return pooled;
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+
+    void* page = alloc_pages(0);
+    if (page) {
+        memset(page, 0, PAGE_SIZE);
+    }
+    return page;
+}
+
+bool pmm_refill_zero_pool(void) {
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    bool full = zero_pool_count >= PMM_ZERO_POOL;
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    if (full) return false;
+
+    void* page = alloc_pages(0);
+    if (page == NULL) return false;
+
+    // Zero with interrupts on; the page is ours until it is pooled
+    memset(page, 0, PAGE_SIZE);
+
+    flags = spin_lock_irqsave(&pmm_lock);
+    if (zero_pool_count < PMM_ZERO_POOL) {
+        zero_pool[zero_pool_count++] = page;
+        page = NULL;
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+
+    // Filled by someone else meanwhile
+    if (page) free_pages(page, 0);
+    return page == NULL;
+}
+
+unsigned int pmm_order_for(size_t bytes) {
+    size_t pages = (bytes + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    unsigned int order = 0;
+    while (((size_t)1 << order) < pages) {
+        order++;
+    }
+    return order;
+}
+
+size_t pmm_get_free(void) {
+    return free_page_count * PAGE_SIZE;
+}
+
+size_t pmm_get_total(void) {
+    return total_pages * PAGE_SIZE;
+}
+
+void pmm_get_stats(pmm_stats_t* stats) {
+    if (stats == NULL) return;
+
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    stats->total_pages = total_pages;
+    stats->free_pages = free_page_count;
+    stats->reserved_pages = page_count - total_pages;
+    stats->highest_addr = highest_addr;
+    stats->zeroed_pages = zero_pool_count;
+    for (int i = 0; i <= PMM_MAX_ORDER; i++) {
+        stats->free_blocks[i] = free_area_count[i];
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
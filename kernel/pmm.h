@@ -0,0 +1,73 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "multiboot.h"
+
+// Physical page frame allocator (binary buddy system). Blocks of
+// 2^order pages are handed out; freeing a block merges it with its
+// buddy whenever the buddy is free too.
+
+#define PAGE_SIZE       4096
+#define PAGE_SHIFT      12
+#define PMM_MAX_ORDER   10            // Largest block: 4 MB
+#define PMM_ZERO_POOL   16            // Pre-zeroed pages kept in reserve
+
+// Per-page metadata
+typedef struct page {
+    struct page* next;        // Free list link (head page of a free block)
+    struct page* prev;
+    uint8_t order;            // Block order, valid on head pages
+    uint8_t flags;
+    uint16_t reserved;
+} page_t;
+
+#define PAGE_FLAG_FREE     0x01   // Head page of a free block
+#define PAGE_FLAG_RESERVED 0x02   // Never handed out (not RAM, kernel, ...)
+
+// Physical memory statistics
+typedef struct {
+    size_t total_pages;       // Usable pages managed by the allocator
+    size_t free_pages;
+    size_t reserved_pages;    // Pages below the highest address not managed
+    uint32_t highest_addr;    // End of the highest usable range
+    size_t zeroed_pages;      // Held in the pre-zeroed pool
+    uint32_t free_blocks[PMM_MAX_ORDER + 1];
+} pmm_stats_t;
+
+// Initialize from the multiboot memory map; reserved_end is the first
+// byte after the kernel image that the allocator may use
+void pmm_init(multiboot_info_t* mbi, uint32_t reserved_end);
+
+// Allocate 2^order contiguous pages, or NULL
+void* alloc_pages(unsigned int order);
+
+// Allocate 2^order contiguous pages ending at or below limit, or NULL
+void* alloc_pages_below(unsigned int order, uint32_t limit);
+
+// Free a block previously returned by alloc_pages with the same order
+void free_pages(void* addr, unsigned int order);
+
+// Allocate one zero-filled page, from the pre-zeroed pool when it can.
+// Free it with free_pages(addr, 0).
+void* alloc_zeroed_page(void);
+
+// Zero one more page into the pool; returns false once it is full (or
+// memory ran out). Meant for idle time.
+bool pmm_refill_zero_pool(void);
+
+// Smallest order whose block holds the given number of bytes
+unsigned int pmm_order_for(size_t bytes);
+
+// Get free memory in bytes
+size_t pmm_get_free(void);
+
+// Get managed memory in bytes
+size_t pmm_get_total(void);
+
+// Get detailed statistics
+void pmm_get_stats(pmm_stats_t* stats);
+
+#endif // PMM_H
@@ -0,0 +1,73 @@
+#include "serial.h"
+#include "io.h"
+
+static bool present = false;
+
+// UART registers, relative to the base port
+#define UART_DATA        0
+#define UART_INT_ENABLE  1
+#define UART_DIVISOR_LO  0   // With DLAB set
+#define UART_DIVISOR_HI  1
+#define UART_FIFO_CTRL   2
+#define UART_LINE_CTRL   3
+#define UART_MODEM_CTRL  4
+#define UART_LINE_STATUS 5
+
+#define LSR_TX_EMPTY     0x20
+#define MCR_LOOPBACK     0x10
+
+bool serial_init(void) {
+    uint16_t port = SERIAL_COM1;
+
+    outb(port + UART_INT_ENABLE, 0x00);  // Polled, no interrupts
+    outb(port + UART_LINE_CTRL, 0x80);   // DLAB on
+    outb(port + UART_DIVISOR_LO, 0x01);  // 115200 baud
+    outb(port + UART_DIVISOR_HI, 0x00);
+    outb(port + UART_LINE_CTRL, 0x03);   // 8N1, DLAB off
+    outb(port + UART_FIFO_CTRL, 0xC7);   // FIFOs on and cleared
+
+    // Loopback self-test: a missing UART reads back 0xFF
+    outb(port + UART_MODEM_CTRL, MCR_LOOPBACK | 0x0B);
+    outb(port + UART_DATA, 0xAE);
+    present = inb(port + UART_DATA) == 0xAE;
+
+    outb(port + UART_MODEM_CTRL, 0x0B);  // Normal operation, DTR/RTS on
+    return present;
+}
+
+bool serial_present(void) {
+    return present;
+}
+
+void serial_putchar(char c) {
+    if (!present) return;
+
+    while (!(inb(SERIAL_COM1 + UART_LINE_STATUS) & LSR_TX_EMPTY)) {
+        // Wait for room
+    }
+    outb(SERIAL_COM1 + UART_DATA, (uint8_t)c);
+}
+
+void serial_puts(const char* str) {
+    for (; *str; str++) {
+        if (*str == '\n') {
+            serial_putchar('\r');
+        }
+        serial_putchar(*str);
+    }
+}
+
+void serial_put_uint(uint32_t value, int base) {
+    char buf[12];
+    int i = 0;
+
+    do {
+        uint32_t digit = value % base;
+        buf[i++] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value);
+
+    while (i > 0) {
+        serial_putchar(buf[--i]);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// COM1, polled. QEMU shows it with -serial stdio or -serial file:...
+#define SERIAL_COM1 0x3F8
+
+// Initialize COM1 at 115200 8N1; returns false if no UART answers
+bool serial_init(void);
+
+// Check whether the port was found
+bool serial_present(void);
+
+// Write one character (waits for the transmitter)
+void serial_putchar(char c);
+
+// Write a string, turning \n into \r\n
+void serial_puts(const char* str);
+
+// Write an unsigned number in the given base (10 or 16)
+void serial_put_uint(uint32_t value, int base);
+
+#endif // SERIAL_H
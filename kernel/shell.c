@@ -3,11 +3,21 @@
 #include "keyboard.h"
 #include "string.h"
 #include "memory.h"
+#include "slab.h"
+#include "pmm.h"
+#include "paging.h"
+#include "dma.h"
+#include "serial.h"
 #include "io.h"
 #include "disk.h"
 #include "network.h"
 #include "gui.h"
 #include "audio.h"
+#include "kbench.h"
+#include "timer.h"
+#include "ktimer.h"
+#include "work.h"
+#include "math64.h"
 #include "apps/notepad.h"
 #include "apps/browser.h"
 #include "apps/diskmgr.h"
@@ -21,8 +31,19 @@ static app_type_t current_app = APP_SHELL;
 #define CMD_BUFFER_SIZE 256
 static char cmd_buffer[CMD_BUFFER_SIZE];
 
+// Heap bytes zeroed per idle step, small enough to stay responsive
+#define SHELL_IDLE_ZERO_STEP 16384
+
+// Idle work between keystrokes: top up the pre-zeroed page pool, then
+// zero free heap memory so kcalloc finds it clean
+static bool shell_idle(void) {
+    if (pmm_refill_zero_pool()) return true;
+    return memory_zero_idle(SHELL_IDLE_ZERO_STEP);
+}
+
 void shell_init(void) {
     current_app = APP_SHELL;
+    keyboard_set_idle_handler(shell_idle);
     shell_refresh();
 }
 
@@ -95,6 +116,10 @@ void shell_show_help(void) {
     vga_puts("  settings - Open settings\n");
     vga_puts("  sysmon   - Open system monitor\n");
     vga_puts("  meminfo  - Show memory information\n");
+    vga_puts("  memprof  - Heap profile by call site (on/off/reset)\n");
+    vga_puts("  memtrace - Log heap calls to COM1 (on/off)\n");
+    vga_puts("  bench    - Run microbenchmarks (bench <name filter>)\n");
+    vga_puts("  irqstat  - Show deferred work and timer statistics\n");
     vga_puts("  diskinfo - Show disk information\n");
     vga_puts("  netinfo  - Show network information\n");
     vga_puts("  wifi     - WiFi control (on/off/scan/list)\n");
@@ -113,6 +138,49 @@ void shell_show_help(void) {
     vga_putchar('\n');
 }
 
+// Print an unsigned number right-aligned in a column of the given width
+static void print_column(uint32_t value, int width) {
+    char buf[12];
+    utoa(value, buf, 10);
+    for (int pad = strlen(buf); pad < width; pad++) vga_putchar(' ');
+    vga_puts(buf);
+}
+
+// Heap trace hook: one "MT op ptr old size align" line per call on the
+// serial port, the format bench/alloc_bench replays. Runs inside the
+// allocator, so it must not allocate.
+static void memtrace_hook(const memory_trace_event_t* event) {
+    serial_puts("MT ");
+    serial_putchar(event->op);
+    serial_putchar(' ');
+    serial_put_uint((uint32_t)event->ptr, 16);
+    serial_putchar(' ');
+    serial_put_uint((uint32_t)event->old_ptr, 16);
+    serial_putchar(' ');
+    serial_put_uint((uint32_t)event->size, 10);
+    serial_putchar(' ');
+    serial_put_uint((uint32_t)event->align, 10);
+    serial_puts("\n");
+}
+
+// Print one benchmark line to the screen and, if there is one, COM1
+static void bench_report(const kbench_result_t* result) {
+    char line[96];
+    char ns[16] = "-";
+    uint32_t khz = timer_tsc_khz();
+
+    // Median in nanoseconds, to a tenth, once the TSC rate is known
+    if (khz) {
+        uint32_t tenth;
+        uint64_t whole = div_u64_rem(div_u64((uint64_t)result->median * 10000000u, khz), 10, &tenth);
+        ksnprintf(ns, sizeof(ns), "%llu.%u", (unsigned long long)whole, tenth);
+    }
+    ksnprintf(line, sizeof(line), "  %-20s %9u %9u %9u %9s  x%u\n",
+              result->name, result->min, result->median, result->p99, ns, result->batch);
+    vga_puts(line);
+    if (serial_present()) serial_puts(line);
+}
+
 void shell_process_command(const char* command) {
     // Skip leading whitespace
     while (*command == ' ') command++;
@@ -151,13 +219,142 @@ void shell_process_command(const char* command) {
         vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
         vga_printf("  Total Heap:     %u bytes\n", (uint32_t)stats.total_size);
         vga_printf("  Free:           %u bytes\n", (uint32_t)stats.free_size);
-        vga_printf("  Used:           %u bytes\n", (uint32_t)stats.used_size);
+        vga_printf("  Used:           %u bytes (%u cached)\n", (uint32_t)stats.used_size,
+                   (uint32_t)stats.cached_size);
         vga_printf("  Largest Free:   %u bytes\n", (uint32_t)stats.largest_free);
         vga_printf("  Block Count:    %u\n", (uint32_t)stats.block_count);
         vga_printf("  Free Blocks:    %u\n", (uint32_t)stats.free_block_count);
         vga_printf("  Allocations:    %u\n", (uint32_t)stats.alloc_count);
         vga_printf("  Frees:          %u\n", (uint32_t)stats.free_count);
         vga_printf("  Failed Allocs:  %u\n", (uint32_t)stats.failed_allocs);
+        pmm_stats_t ps;
+        pmm_get_stats(&ps);
+        vga_printf("  Physical RAM:   %u KB (%u KB free, %u KB pre-zeroed)\n",
+                   (uint32_t)(pmm_get_total() / 1024), (uint32_t)(pmm_get_free() / 1024),
+                   (uint32_t)ps.zeroed_pages * 4);
+        paging_stats_t pg;
+        paging_get_stats(&pg);
+        vga_printf("  Heap Resident:  %u KB of %u KB reserved\n",
+                   pg.heap_resident * 4, (pg.heap_brk - pg.heap_start) / 1024);
+        dma_stats_t ds;
+        dma_get_stats(&ds);
+        vga_printf("  DMA Pool:       %u KB (%u KB free) at 0x%X\n",
+                   (uint32_t)(ds.size / 1024), (uint32_t)(ds.free / 1024), ds.base);
+
+        kmem_cache_t* cache = kmem_cache_next(NULL);
+        if (cache) {
+            vga_set_color(vga_entry_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+            vga_puts("\n=== Object Caches ===\n");
+            vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+        }
+        for (; cache; cache = kmem_cache_next(cache)) {
+            kmem_cache_stats_t cs;
+            kmem_cache_get_stats(cache, &cs);
+            vga_printf("  %s", cs.name);
+            for (int pad = strlen(cs.name); pad < 12; pad++) vga_putchar(' ');
+            vga_printf("  %u B  objs %u/%u  slabs %u  allocs %u  frees %u\n", (uint32_t)cs.obj_size,
+                       cs.active_objs, cs.total_objs, cs.slab_count,
+                       cs.alloc_count, cs.free_count);
+        }
+        vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        vga_putchar('\n');
+    }
+    else if (strcmp(command, "memprof on") == 0) {
+        memory_profile_enable(true);
+        vga_puts("Heap profiling enabled.\n");
+    }
+    else if (strcmp(command, "memprof off") == 0) {
+        memory_profile_enable(false);
+        vga_puts("Heap profiling disabled.\n");
+    }
+    else if (strcmp(command, "memprof reset") == 0) {
+        memory_profile_reset();
+        vga_puts("Heap profile cleared.\n");
+    }
+    else if (strcmp(command, "memprof") == 0) {
+        memprof_site_t sites[12];
+        int count = memory_profile_top(sites, 12);
+        
+        vga_set_color(vga_entry_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+        vga_printf("\n=== Heap Profile (%s) ===\n", memory_profile_enabled() ? "on" : "off");
+        vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+        if (count == 0) {
+            vga_puts("  No sites recorded. Use 'memprof on' to start.\n");
+        } else {
+            vga_puts("  Call site   Live bytes  Blocks  Peak bytes  Allocs\n");
+        }
+        for (int i = 0; i < count; i++) {
+            char addr[12];
+            utoa((uint32_t)sites[i].caller, addr, 16);
+            vga_printf("  0x%s", addr);
+            for (int pad = strlen(addr); pad < 8; pad++) vga_putchar(' ');
+            print_column((uint32_t)sites[i].live_bytes, 12);
+            print_column(sites[i].live_count, 8);
+            print_column((uint32_t)sites[i].peak_bytes, 12);
+            print_column(sites[i].alloc_count, 8);
+            vga_putchar('\n');
+        }
+        vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        vga_putchar('\n');
+    }
+    else if (strcmp(command, "memtrace on") == 0) {
+        if (!serial_present()) {
+            vga_puts("No serial port; heap tracing needs COM1.\n");
+        } else {
+            memory_set_trace_hook(memtrace_hook);
+            vga_puts("Heap trace enabled on COM1.\n");
+        }
+    }
+    else if (strcmp(command, "memtrace off") == 0) {
+        memory_set_trace_hook(NULL);
+        vga_puts("Heap trace disabled.\n");
+    }
+    else if (strcmp(command, "bench") == 0 || strncmp(command, "bench ", 6) == 0) {
+        const char* pattern = command[5] ? command + 6 : "";
+        while (*pattern == ' ') pattern++;
+
+        if (!kbench_available()) {
+            vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            vga_puts("No time stamp counter; can't benchmark.\n");
+        } else {
+            vga_set_color(vga_entry_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+            vga_puts("\n=== Benchmarks (cycles per call) ===\n");
+            vga_printf("  %-20s %9s %9s %9s %9s  %s\n", "name", "min", "median", "p99", "ns", "batch");
+            vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+            if (kbench_run(pattern, bench_report) == 0) {
+                vga_printf("  No benchmark matches '%s'\n", pattern);
+            }
+        }
+        vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        vga_putchar('\n');
+    }
+    else if (strcmp(command, "irqstat") == 0) {
+        uint32_t khz = timer_tsc_khz();
+
+        vga_set_color(vga_entry_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+        vga_puts("\n=== Deferred Work ===\n");
+        vga_printf("  %-10s %9s %9s %9s %5s %9s %9s %9s\n", "type", "queued",
+                   "merged", "run", "depth", "max depth", "avg us", "max us");
+        vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+        for (int type = 0; type < WORK_TYPE_COUNT; type++) {
+            work_stats_t ws;
+            work_get_stats((work_type_t)type, &ws);
+
+            // Runtimes need the TSC rate to turn cycles into time
+            char avg[12] = "-";
+            char max[12] = "-";
+            if (khz && ws.run) {
+                ksnprintf(avg, sizeof(avg), "%u", (uint32_t)div_u64(div_u64(ws.cycles, ws.run) * 1000, khz));
+                ksnprintf(max, sizeof(max), "%u", (uint32_t)div_u64((uint64_t)ws.max_cycles * 1000, khz));
+            }
+            vga_printf("  %-10s %9u %9u %9u %5u %9u %9s %9s\n", ws.name, ws.queued,
+                       ws.merged, ws.run, ws.depth, ws.max_depth, avg, max);
+        }
+
+        ktimer_stats_t ts;
+        ktimer_get_stats(&ts);
+        vga_printf("\n  Timers: %u pending, %u fired, %u cascaded\n",
+                   ts.pending, ts.fired, ts.cascaded);
         vga_set_color(vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
         vga_putchar('\n');
     }
@@ -0,0 +1,244 @@
+#include "slab.h"
+#include "memory.h"
+#include "string.h"
+
+// Registered caches
+static kmem_cache_t* cache_list = NULL;
+
+#define KMEM_DEFAULT_ALIGN  sizeof(void*)
+#define KMEM_CACHE_LINE     32        // Colour step, one i486/P5 cache line
+#define KMEM_SLAB_MIN_BYTES 4096
+#define KMEM_SLAB_MIN_OBJS  8
+
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+// Every slot starts with a pointer to its slab, so kmem_cache_free finds
+// the slab in O(1) without any per-allocation kmalloc header.
+static inline kmem_slab_t** slot_owner(void* obj) {
+    return (kmem_slab_t**)((uint8_t*)obj - sizeof(kmem_slab_t*));
+}
+
+static inline void** free_link(kmem_cache_t* cache, void* obj) {
+    return (void**)((uint8_t*)obj + cache->free_offset);
+}
+
+static void slab_list_add(kmem_slab_t** head, kmem_slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+}
+
+static void slab_list_del(kmem_slab_t** head, kmem_slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *head = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = slab->prev = NULL;
+}
+
+// Address of the first object in a slab
+static uint8_t* slab_first_obj(kmem_cache_t* cache, kmem_slab_t* slab) {
+    size_t hdr = ALIGN_UP(sizeof(kmem_slab_t*), cache->align);
+    uintptr_t base = (uintptr_t)slab + sizeof(kmem_slab_t) + slab->colour + hdr;
+    return (uint8_t*)ALIGN_UP(base, cache->align);
+}
+
+// Allocate a new slab and thread all of its objects onto its free list
+static kmem_slab_t* cache_grow(kmem_cache_t* cache) {
+    kmem_slab_t* slab = (kmem_slab_t*)kmalloc(cache->slab_bytes);
+    if (!slab) return NULL;
+
+    slab->cache = cache;
+    slab->next = slab->prev = NULL;
+    slab->inuse = 0;
+
+    // Stagger the first object of successive slabs so hot objects of
+    // different slabs don't all land on the same cache lines
+    slab->colour = cache->colour_next * cache->colour_off;
+    if (++cache->colour_next > cache->colour_max) {
+        cache->colour_next = 0;
+    }
+
+    uint8_t* obj = slab_first_obj(cache, slab);
+    slab->free_list = NULL;
+    for (uint32_t i = 0; i < cache->objs_per_slab; i++) {
+        uint8_t* o = obj + (cache->objs_per_slab - 1 - i) * cache->slot_size;
+        *slot_owner(o) = slab;
+        if (cache->ctor) {
+            cache->ctor(o);
+        }
+        *free_link(cache, o) = slab->free_list;
+        slab->free_list = o;
+    }
+
+    cache->slab_count++;
+    return slab;
+}
+
+static void cache_release_slab(kmem_cache_t* cache, kmem_slab_t* slab) {
+    slab->cache = NULL;
+    kfree(slab);
+    cache->slab_count--;
+}
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align,
+                                kmem_ctor_t ctor) {
+    if (size == 0) return NULL;
+    if (align == 0) align = KMEM_DEFAULT_ALIGN;
+    if (align & (align - 1)) return NULL;
+    if (align < sizeof(void*)) align = sizeof(void*);
+
+    kmem_cache_t* cache = (kmem_cache_t*)kcalloc(1, sizeof(kmem_cache_t));
+    if (!cache) return NULL;
+
+    strncpy(cache->name, name ? name : "cache", KMEM_CACHE_NAME_LEN - 1);
+    cache->name[KMEM_CACHE_NAME_LEN - 1] = '\0';
+    cache->obj_size = size;
+    cache->align = align;
+    cache->ctor = ctor;
+
+    // Without a constructor the free-list link overlays the object itself;
+    // with one it goes after the object so constructed state survives
+    size_t obj_bytes = size < sizeof(void*) ? sizeof(void*) : size;
+    if (ctor) {
+        cache->free_offset = ALIGN_UP(obj_bytes, sizeof(void*));
+        obj_bytes = cache->free_offset + sizeof(void*);
+    } else {
+        cache->free_offset = 0;
+    }
+    cache->slot_size = ALIGN_UP(ALIGN_UP(sizeof(kmem_slab_t*), align) + obj_bytes, align);
+
+    // Size slabs to hold at least KMEM_SLAB_MIN_OBJS objects; align - 1
+    // bytes are reserved since kmalloc only guarantees 8-byte alignment
+    size_t overhead = sizeof(kmem_slab_t) + align - 1;
+    size_t slab_bytes = KMEM_SLAB_MIN_BYTES;
+    if (slab_bytes < overhead + KMEM_SLAB_MIN_OBJS * cache->slot_size) {
+        slab_bytes = overhead + KMEM_SLAB_MIN_OBJS * cache->slot_size;
+    }
+    cache->slab_bytes = slab_bytes;
+    cache->objs_per_slab = (slab_bytes - overhead) / cache->slot_size;
+
+    // Leftover space in each slab is spent on colouring
+    size_t leftover = slab_bytes - overhead - cache->objs_per_slab * cache->slot_size;
+    cache->colour_off = align > KMEM_CACHE_LINE ? align : KMEM_CACHE_LINE;
+    cache->colour_max = leftover / cache->colour_off;
+    cache->colour_next = 0;
+
+    cache->next = cache_list;
+    cache_list = cache;
+
+    return cache;
+}
+
+bool kmem_cache_destroy(kmem_cache_t* cache) {
+    if (!cache || cache->active_objs != 0) return false;
+
+    kmem_cache_shrink(cache);
+
+    kmem_cache_t** link = &cache_list;
+    while (*link && *link != cache) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = cache->next;
+    }
+
+    kfree(cache);
+    return true;
+}
+
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    if (!cache) return NULL;
+
+    kmem_slab_t* slab = cache->partial;
+    if (!slab) {
+        if (cache->empty) {
+            slab = cache->empty;
+            slab_list_del(&cache->empty, slab);
+        } else {
+            slab = cache_grow(cache);
+            if (!slab) {
+                cache->failed_allocs++;
+                return NULL;
+            }
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    void* obj = slab->free_list;
+    slab->free_list = *free_link(cache, obj);
+    slab->inuse++;
+
+    if (!slab->free_list) {
+        slab_list_del(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+
+    cache->active_objs++;
+    cache->alloc_count++;
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    if (!cache || !obj) return;
+
+    kmem_slab_t* slab = *slot_owner(obj);
+    if (!slab || slab->cache != cache || slab->inuse == 0) return;
+
+    bool was_full = (slab->free_list == NULL);
+    *free_link(cache, obj) = slab->free_list;
+    slab->free_list = obj;
+    slab->inuse--;
+
+    if (was_full) {
+        slab_list_del(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    if (slab->inuse == 0) {
+        slab_list_del(&cache->partial, slab);
+        // Keep one empty slab around to absorb alloc/free churn
+        if (cache->empty) {
+            cache_release_slab(cache, slab);
+        } else {
+            slab_list_add(&cache->empty, slab);
+        }
+    }
+
+    cache->active_objs--;
+    cache->free_count++;
+}
+
+void kmem_cache_shrink(kmem_cache_t* cache) {
+    if (!cache) return;
+
+    while (cache->empty) {
+        kmem_slab_t* slab = cache->empty;
+        slab_list_del(&cache->empty, slab);
+        cache_release_slab(cache, slab);
+    }
+}
+
+void kmem_cache_get_stats(kmem_cache_t* cache, kmem_cache_stats_t* stats) {
+    if (!cache || !stats) return;
+
+    stats->name = cache->name;
+    stats->obj_size = cache->obj_size;
+    stats->slab_count = cache->slab_count;
+    stats->active_objs = cache->active_objs;
+    stats->total_objs = cache->slab_count * cache->objs_per_slab;
+    stats->alloc_count = cache->alloc_count;
+    stats->free_count = cache->free_count;
+    stats->failed_allocs = cache->failed_allocs;
+}
+
+kmem_cache_t* kmem_cache_next(kmem_cache_t* cache) {
+    return cache ? cache->next : cache_list;
+}
@@ -0,0 +1,91 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Object caches for fixed-size kernel objects, layered on kmalloc.
+// Each cache carves large kmalloc'd slabs into equal slots, so an
+// allocation is a free-list pop instead of a heap search.
+
+#define KMEM_CACHE_NAME_LEN 24
+
+// Constructor run once per object when its slab is created; objects
+// handed back to kmem_cache_free must be left in constructed state
+typedef void (*kmem_ctor_t)(void* obj);
+
+struct kmem_cache;
+
+// Slab header, placed at the start of each slab allocation
+typedef struct kmem_slab {
+    struct kmem_cache* cache;
+    struct kmem_slab* next;
+    struct kmem_slab* prev;
+    void* free_list;          // First free object in this slab
+    uint32_t inuse;           // Objects currently allocated
+    uint32_t colour;          // Offset of the first object (bytes)
+} kmem_slab_t;
+
+// Object cache
+typedef struct kmem_cache {
+    char name[KMEM_CACHE_NAME_LEN];
+    size_t obj_size;          // Size requested by the creator
+    size_t align;             // Object alignment
+    size_t slot_size;         // Back pointer + object (+ free link)
+    size_t free_offset;       // Free-list link offset within the object
+    size_t slab_bytes;        // Size of one slab allocation
+    uint32_t objs_per_slab;
+    size_t colour_off;        // Colour granularity (bytes)
+    uint32_t colour_max;      // Number of distinct colours
+    uint32_t colour_next;     // Colour for the next slab
+    kmem_ctor_t ctor;
+
+    kmem_slab_t* partial;     // Slabs with free and used objects
+    kmem_slab_t* full;        // Slabs with no free objects
+    kmem_slab_t* empty;       // Slabs with no used objects
+
+    uint32_t slab_count;
+    uint32_t active_objs;
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t failed_allocs;
+
+    struct kmem_cache* next;  // Cache registry
+} kmem_cache_t;
+
+// Per-cache statistics
+typedef struct {
+    const char* name;
+    size_t obj_size;
+    uint32_t slab_count;
+    uint32_t active_objs;
+    uint32_t total_objs;
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t failed_allocs;
+} kmem_cache_stats_t;
+
+// Create a cache of objects of the given size (align 0 = default)
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align,
+                                kmem_ctor_t ctor);
+
+// Destroy a cache; fails if objects are still allocated
+bool kmem_cache_destroy(kmem_cache_t* cache);
+
+// Allocate an object from a cache
+void* kmem_cache_alloc(kmem_cache_t* cache);
+
+// Return an object to its cache
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+// Release all empty slabs back to the heap
+void kmem_cache_shrink(kmem_cache_t* cache);
+
+// Get statistics for one cache
+void kmem_cache_get_stats(kmem_cache_t* cache, kmem_cache_stats_t* stats);
+
+// Iterate registered caches (pass NULL to get the first)
+kmem_cache_t* kmem_cache_next(kmem_cache_t* cache);
+
+#endif // SLAB_H
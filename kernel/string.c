@@ -1,11 +1,146 @@
 #include "string.h"
+#include "cpu.h"
+#include "math64.h"
+#include "sync.h"
 
-size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len]) {
-        len++;
+// Below this many bytes a plain word loop beats REP start-up cost
+#define COPY_SMALL   128
+
+// At or above this many bytes, copies use SSE2 streaming stores so a big
+// copy doesn't flush the cache
+#define COPY_STREAM  (256 * 1024)
+
+// Bytes moved per interrupts-off stretch in the SSE2 loops
+#define STREAM_CHUNK 4096
+
+// XMM registers the SSE2 loops use, for their clobber lists. Without SSE
+// enabled (the kernel build) the compiler neither knows nor allocates them.
+#ifdef __SSE__
+#define CLOBBER_XMM0    "xmm0",
+#define CLOBBER_XMM0_3  "xmm0", "xmm1", "xmm2", "xmm3",
+#else
+#define CLOBBER_XMM0
+#define CLOBBER_XMM0_3
+#endif
+
+// Bytes scanned a word at a time before the SSE2 loop takes over
+#define SCAN_SWAR    64
+
+// Below these sizes memmem skips the Horspool table
+#define SEARCH_MIN_NEEDLE   4
+#define SEARCH_MIN_HAYSTACK 128
+
+// Bytes in a page; aligned loads never cross one
+#define PAGE_BYTES   4096
+
+// Unaligned, alias-safe 32-bit access
+typedef uint32_t __attribute__((may_alias, aligned(1))) word_t;
+
+static void copy_rep_movsd(void* dest, const void* src, size_t n);
+static void fill_rep_stosd(void* dest, uint32_t pattern, size_t n);
+
+// Medium-size strategy, streaming cut-over and SSE2 use, chosen by string_init
+static void (*copy_medium)(void*, const void*, size_t) = copy_rep_movsd;
+static void (*fill_medium)(void*, uint32_t, size_t) = fill_rep_stosd;
+static size_t stream_threshold = (size_t)-1;
+static bool have_sse2 = false;
+static const char* variant_name = "rep movsd";
+
+// SWAR byte tests: ONES has 1 in every byte, HIGHS the top bit of each
+#define ONES  0x01010101u
+#define HIGHS 0x80808080u
+
+// Top bit set in each zero byte of w at or below the lowest zero byte;
+// bits above it can be false hits, so only the lowest one is exact
+static inline uint32_t zero_bytes(uint32_t w) {
+    return (w - ONES) & ~w & HIGHS;
+}
+
+// Top bit set in exactly the zero bytes of w
+static inline uint32_t zero_bytes_exact(uint32_t w) {
+    return ~(((w & ~HIGHS) + ~HIGHS) | w | ~HIGHS);
+}
+
+// Whether a load of len bytes at p stays inside p's page
+static inline bool fits_in_page(const void* p, size_t len) {
+    return ((uintptr_t)p & (PAGE_BYTES - 1)) <= PAGE_BYTES - len;
+}
+
+// Scan 16-byte aligned blocks from *p, at most limit bytes (a multiple of
+// 16), for bytes matching either pattern (a byte repeated four times).
+// Returns the hit mask of the first block with hits and leaves *p on it,
+// or 0 with *p past the scanned bytes. XMM state isn't saved across
+// interrupts, so each chunk runs with them masked.
+static uint32_t scan_sse2(const unsigned char** p, uint32_t a, uint32_t b, size_t limit) {
+    const unsigned char* q = *p;
+    uint32_t mask = 0;
+    
+    while (limit > 0 && mask == 0) {
+        size_t chunk = limit < STREAM_CHUNK ? limit : STREAM_CHUNK;
+        limit -= chunk;
+        uint32_t flags = irq_save();
+        __asm__ volatile ("movd %3, %%xmm1\n\t"
+                          "pshufd $0, %%xmm1, %%xmm1\n\t"
+                          "movd %4, %%xmm2\n\t"
+                          "pshufd $0, %%xmm2, %%xmm2\n\t"
+                          "1:\n\t"
+                          "movdqa (%0), %%xmm0\n\t"
+                          "movdqa %%xmm0, %%xmm3\n\t"
+                          "pcmpeqb %%xmm1, %%xmm0\n\t"
+                          "pcmpeqb %%xmm2, %%xmm3\n\t"
+                          "por %%xmm3, %%xmm0\n\t"
+                          "pmovmskb %%xmm0, %2\n\t"
+                          "test %2, %2\n\t"
+                          "jnz 2f\n\t"
+                          "add $16, %0\n\t"
+                          "sub $16, %1\n\t"
+                          "jnz 1b\n\t"
+                          "2:"
+                          : "+r"(q), "+r"(chunk), "=&r"(mask)
+                          : "r"(a), "r"(b) : CLOBBER_XMM0_3 "memory", "cc");
+        irq_restore(flags);
     }
-    return len;
+    *p = q;
+    return mask;
+}
+
+// First byte equal to c (or NUL too, if nul) in the n bytes at p, or NULL.
+// Reads are aligned words or blocks, so they never touch the next page.
+static const unsigned char* find_byte(const unsigned char* p, unsigned char c, bool nul, size_t n) {
+    uint32_t cpat = c * ONES;
+    uint32_t npat = nul ? 0 : cpat;
+    
+    // Bytes up to a word boundary
+    for (; n > 0 && ((uintptr_t)p & 3); p++, n--) {
+        if (*p == c || (nul && *p == 0)) return p;
+    }
+    
+    // Words; with SSE2, only SCAN_SWAR bytes and up to a block boundary
+    size_t swar = have_sse2 ? SCAN_SWAR : n;
+    while (n >= 4 && (swar >= 4 || ((uintptr_t)p & 15))) {
+        uint32_t w = *(const word_t*)p;
+        uint32_t hits = zero_bytes(w ^ cpat) | zero_bytes(w ^ npat);
+        if (hits) return p + (__builtin_ctz(hits) >> 3);
+        p += 4;
+        n -= 4;
+        if (swar >= 4) swar -= 4;
+    }
+    
+    if (have_sse2 && n >= 16) {
+        size_t blocks = n & ~(size_t)15;
+        uint32_t mask = scan_sse2(&p, cpat, npat, blocks);
+        if (mask) return p + __builtin_ctz(mask);
+        n -= blocks;
+    }
+    
+    for (; n > 0; p++, n--) {
+        if (*p == c || (nul && *p == 0)) return p;
+    }
+    return NULL;
+}
+
+size_t strlen(const char* str) {
+    return (const char*)find_byte((const unsigned char*)str, 0, true, (size_t)-1) - str;
 }
 
 char* strcpy(char* dest, const char* src) {
@@ -16,7 +151,8 @@ char* strcpy(char* dest, const char* src) {
 
 char* strncpy(char* dest, const char* src, size_t n) {
     char* original = dest;
-    while (n && (*dest++ = *src++)) {
+    while (n && *src) {
+        *dest++ = *src++;
         n--;
     }
     while (n--) {
@@ -26,21 +162,47 @@ char* strncpy(char* dest, const char* src, size_t n) {
 }
 
 int strcmp(const char* s1, const char* s2) {
-    while (*s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
+    const unsigned char* a = (const unsigned char*)s1;
+    const unsigned char* b = (const unsigned char*)s2;
+    
+    for (;;) {
+        // A word at a time while neither load can run into the next page
+        if (fits_in_page(a, 4) && fits_in_page(b, 4)) {
+            uint32_t wa = *(const word_t*)a;
+            uint32_t wb = *(const word_t*)b;
+            if (wa == wb && !zero_bytes(wa)) {
+                a += 4;
+                b += 4;
+                continue;
+            }
+        }
+        if (*a != *b || *a == 0) return *a - *b;
+        a++;
+        b++;
     }
-    return *(unsigned char*)s1 - *(unsigned char*)s2;
 }
 
 int strncmp(const char* s1, const char* s2, size_t n) {
-    while (n && *s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
+    const unsigned char* a = (const unsigned char*)s1;
+    const unsigned char* b = (const unsigned char*)s2;
+    
+    while (n > 0) {
+        if (n >= 4 && fits_in_page(a, 4) && fits_in_page(b, 4)) {
+            uint32_t wa = *(const word_t*)a;
+            uint32_t wb = *(const word_t*)b;
+            if (wa == wb && !zero_bytes(wa)) {
+                a += 4;
+                b += 4;
+                n -= 4;
+                continue;
+            }
+        }
+        if (*a != *b || *a == 0) return *a - *b;
+        a++;
+        b++;
         n--;
     }
-    if (n == 0) return 0;
-    return *(unsigned char*)s1 - *(unsigned char*)s2;
+    return 0;
 }
 
 char* strcat(char* dest, const char* src) {
@@ -53,58 +215,280 @@ char* strcat(char* dest, const char* src) {
 }
 
 char* strchr(const char* str, int c) {
-    while (*str) {
-        if (*str == c) {
-            return (char*)str;
-        }
-        str++;
+    const unsigned char* p = find_byte((const unsigned char*)str, (unsigned char)c, true, (size_t)-1);
+    return (*p == (unsigned char)c) ? (char*)p : NULL;
+}
+
+void* memchr(const void* ptr, int c, size_t num) {
+    return (void*)find_byte((const unsigned char*)ptr, (unsigned char)c, false, num);
+}
+
+void* memrchr(const void* ptr, int c, size_t num) {
+    const unsigned char* base = (const unsigned char*)ptr;
+    const unsigned char* p = base + num;
+    uint32_t cpat = (unsigned char)c * ONES;
+    
+    // Bytes down to a word boundary, then aligned words from the top
+    while (p > base && ((uintptr_t)p & 3)) {
+        if (*--p == (unsigned char)c) return (void*)p;
+    }
+    while ((size_t)(p - base) >= 4) {
+        p -= 4;
+        uint32_t hits = zero_bytes_exact(*(const word_t*)p ^ cpat);
+        if (hits) return (void*)(p + ((31 - __builtin_clz(hits)) >> 3));
+    }
+    while (p > base) {
+        if (*--p == (unsigned char)c) return (void*)p;
     }
-    return (c == '\0') ? (char*)str : NULL;
+    return NULL;
 }
 
 char* strstr(const char* haystack, const char* needle) {
-    if (!*needle) return (char*)haystack;
-    for (; *haystack; haystack++) {
-        const char* h = haystack;
-        const char* n = needle;
-        while (*h && *n && *h == *n) { h++; n++; }
-        if (!*n) return (char*)haystack;
+    size_t nlen = strlen(needle);
+    if (nlen == 0) return (char*)haystack;
+    
+    // Skip to the first candidate before measuring what is left
+    haystack = strchr(haystack, needle[0]);
+    if (haystack == NULL) return NULL;
+    return memmem(haystack, strlen(haystack), needle, nlen);
+}
+
+void* memmem(const void* haystack, size_t hlen, const void* needle, size_t nlen) {
+    const unsigned char* h = (const unsigned char*)haystack;
+    const unsigned char* n = (const unsigned char*)needle;
+    
+    if (nlen == 0) return (void*)h;
+    if (nlen > hlen) return NULL;
+    
+    // Short needle or haystack: the bad-character table wouldn't pay for
+    // itself, so jump between first-byte matches with memchr instead
+    if (nlen < SEARCH_MIN_NEEDLE || hlen < SEARCH_MIN_HAYSTACK) {
+        const unsigned char* last = h + (hlen - nlen);
+        while (h <= last) {
+            h = memchr(h, n[0], last - h + 1);
+            if (h == NULL) return NULL;
+            if (memcmp(h + 1, n + 1, nlen - 1) == 0) return (void*)h;
+            h++;
+        }
+        return NULL;
+    }
+    
+    // Boyer-Moore-Horspool: on a miss, slide until the byte under the
+    // window's end lines up with its last occurrence in the needle
+    // (shifts are capped so they fit the table; smaller is still correct)
+    uint16_t shift[256];
+    size_t max_shift = nlen < 0xFFFF ? nlen : 0xFFFF;
+    for (int i = 0; i < 256; i++) {
+        shift[i] = (uint16_t)max_shift;
+    }
+    for (size_t i = 0; i + 1 < nlen; i++) {
+        size_t dist = nlen - 1 - i;
+        shift[n[i]] = (uint16_t)(dist < max_shift ? dist : max_shift);
+    }
+    
+    unsigned char tail = n[nlen - 1];
+    for (size_t pos = 0; pos <= hlen - nlen; pos += shift[h[pos + nlen - 1]]) {
+        if (h[pos + nlen - 1] == tail && memcmp(h + pos, n, nlen - 1) == 0) {
+            return (void*)(h + pos);
+        }
     }
     return NULL;
 }
 
+static void copy_rep_movsd(void* dest, const void* src, size_t n) {
+    size_t dwords = n / 4;
+    
+    __asm__ volatile ("rep movsl\n\t"
+                      "movl %3, %%ecx\n\t"
+                      "rep movsb"
+                      : "+D"(dest), "+S"(src), "+c"(dwords)
+                      : "r"((uint32_t)(n % 4)) : "memory");
+}
+
+static void copy_rep_movsb(void* dest, const void* src, size_t n) {
+    __asm__ volatile ("rep movsb" : "+D"(dest), "+S"(src), "+c"(n) : : "memory");
+}
+
+static void fill_rep_stosd(void* dest, uint32_t pattern, size_t n) {
+    size_t dwords = n / 4;
+    
+    __asm__ volatile ("rep stosl\n\t"
+                      "movl %3, %%ecx\n\t"
+                      "rep stosb"
+                      : "+D"(dest), "+c"(dwords)
+                      : "a"(pattern), "r"((uint32_t)(n % 4)) : "memory");
+}
+
+static void fill_rep_stosb(void* dest, uint32_t pattern, size_t n) {
+    __asm__ volatile ("rep stosb" : "+D"(dest), "+c"(n) : "a"(pattern) : "memory");
+}
+
+static inline void copy_words(unsigned char* d, const unsigned char* s, size_t n) {
+    for (; n >= 4; n -= 4, d += 4, s += 4) {
+        *(word_t*)d = *(const word_t*)s;
+    }
+    while (n--) {
+        *d++ = *s++;
+    }
+}
+
+static inline void fill_words(unsigned char* d, uint32_t pattern, size_t n) {
+    for (; n >= 4; n -= 4, d += 4) {
+        *(word_t*)d = pattern;
+    }
+    while (n--) {
+        *d++ = (unsigned char)pattern;
+    }
+}
+
+// Copy with SSE2 non-temporal stores, 64 bytes per step. Nothing saves the
+// XMM registers across an interrupt, so each chunk runs with them masked.
+static void copy_stream(unsigned char* d, const unsigned char* s, size_t n) {
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    copy_medium(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+    
+    while (n >= 64) {
+        size_t chunk = n < STREAM_CHUNK ? (n & ~(size_t)63) : STREAM_CHUNK;
+        n -= chunk;
+        uint32_t flags = irq_save();
+        __asm__ volatile ("1:\n\t"
+                          "movdqu   (%1), %%xmm0\n\t"
+                          "movdqu 16(%1), %%xmm1\n\t"
+                          "movdqu 32(%1), %%xmm2\n\t"
+                          "movdqu 48(%1), %%xmm3\n\t"
+                          "movntdq %%xmm0,   (%0)\n\t"
+                          "movntdq %%xmm1, 16(%0)\n\t"
+                          "movntdq %%xmm2, 32(%0)\n\t"
+                          "movntdq %%xmm3, 48(%0)\n\t"
+                          "add $64, %0\n\t"
+                          "add $64, %1\n\t"
+                          "sub $64, %2\n\t"
+                          "jnz 1b\n\t"
+                          "sfence"
+                          : "+r"(d), "+r"(s), "+r"(chunk)
+                          : : CLOBBER_XMM0_3 "memory", "cc");
+        irq_restore(flags);
+    }
+    copy_medium(d, s, n);
+}
+
+static void fill_stream(unsigned char* d, uint32_t pattern, size_t n) {
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    fill_medium(d, pattern, head);
+    d += head;
+    n -= head;
+    
+    while (n >= 64) {
+        size_t chunk = n < STREAM_CHUNK ? (n & ~(size_t)63) : STREAM_CHUNK;
+        n -= chunk;
+        uint32_t flags = irq_save();
+        __asm__ volatile ("movd %2, %%xmm0\n\t"
+                          "pshufd $0, %%xmm0, %%xmm0\n\t"
+                          "1:\n\t"
+                          "movntdq %%xmm0,   (%0)\n\t"
+                          "movntdq %%xmm0, 16(%0)\n\t"
+                          "movntdq %%xmm0, 32(%0)\n\t"
+                          "movntdq %%xmm0, 48(%0)\n\t"
+                          "add $64, %0\n\t"
+                          "sub $64, %1\n\t"
+                          "jnz 1b\n\t"
+                          "sfence"
+                          : "+r"(d), "+r"(chunk) : "r"(pattern)
+                          : CLOBBER_XMM0 "memory", "cc");
+        irq_restore(flags);
+    }
+    fill_medium(d, pattern, n);
+}
+
+// Copy high addresses first, for memmove with dest above src
+static void copy_backward(unsigned char* d, const unsigned char* s, size_t n) {
+    // Odd tail bytes first, leaving a whole number of words
+    while (n & 3) {
+        n--;
+        d[n] = s[n];
+    }
+    
+    if (n >= COPY_SMALL) {
+        void* dw = d + n - 4;
+        const void* sw = s + n - 4;
+        size_t dwords = n / 4;
+        __asm__ volatile ("std\n\t"
+                          "rep movsl\n\t"
+                          "cld"
+                          : "+D"(dw), "+S"(sw), "+c"(dwords) : : "memory");
+        return;
+    }
+    while (n) {
+        n -= 4;
+        *(word_t*)(d + n) = *(const word_t*)(s + n);
+    }
+}
+
+void string_init(void) {
+    uint32_t max_leaf = cpu_max_leaf();
+    uint32_t edx = cpu_features_edx();
+    uint32_t a, b = 0, c, d;
+    
+    if (max_leaf >= 7) {
+        cpuid(7, &a, &b, &c, &d);
+    }
+    if (b & CPUID_7_EBX_ERMS) {
+        copy_medium = copy_rep_movsb;
+        fill_medium = fill_rep_stosb;
+        variant_name = "ERMS rep movsb";
+    }
+    
+    // SSE needs the OS to declare FXSAVE support before it will execute;
+    // a hosted build runs under an OS that has done so already
+    if ((edx & CPUID_EDX_SSE2) && (edx & CPUID_EDX_FXSR)) {
+#if !__STDC_HOSTED__
+        write_cr0((read_cr0() & ~CR0_EM) | CR0_MP);
+        write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+#endif
+        stream_threshold = COPY_STREAM;
+        have_sse2 = true;
+        variant_name = (b & CPUID_7_EBX_ERMS) ? "ERMS rep movsb, SSE2 streaming"
+                                              : "rep movsd, SSE2 streaming";
+    }
+}
+
+const char* string_variant(void) {
+    return variant_name;
+}
+
 void* memset(void* ptr, int value, size_t num) {
-    unsigned char* p = (unsigned char*)ptr;
-    while (num--) {
-        *p++ = (unsigned char)value;
+    uint32_t pattern = (unsigned char)value * 0x01010101u;
+    
+    if (num < COPY_SMALL) {
+        fill_words((unsigned char*)ptr, pattern, num);
+    } else if (num < stream_threshold) {
+        fill_medium(ptr, pattern, num);
+    } else {
+        fill_stream((unsigned char*)ptr, pattern, num);
     }
     return ptr;
 }
 
 void* memcpy(void* dest, const void* src, size_t num) {
-    unsigned char* d = (unsigned char*)dest;
-    const unsigned char* s = (const unsigned char*)src;
-    while (num--) {
-        *d++ = *s++;
+    if (num < COPY_SMALL) {
+        copy_words((unsigned char*)dest, (const unsigned char*)src, num);
+    } else if (num < stream_threshold) {
+        copy_medium(dest, src, num);
+    } else {
+        copy_stream((unsigned char*)dest, (const unsigned char*)src, num);
     }
     return dest;
 }
 
 void* memmove(void* dest, const void* src, size_t num) {
-    unsigned char* d = (unsigned char*)dest;
-    const unsigned char* s = (const unsigned char*)src;
-    
-    if (d < s) {
-        while (num--) {
-            *d++ = *s++;
-        }
-    } else {
-        d += num;
-        s += num;
-        while (num--) {
-            *--d = *--s;
-        }
+    // A forward copy is safe unless dest starts inside the source
+    if ((uintptr_t)dest - (uintptr_t)src >= num) {
+        return memcpy(dest, src, num);
     }
+    copy_backward((unsigned char*)dest, (const unsigned char*)src, num);
     return dest;
 }
 
@@ -197,6 +581,247 @@ int atoi(const char* str) {
     return sign * result;
 }
 
+// Conversion flags for vsnprintf
+#define FMT_LEFT   0x01     // '-': pad on the right
+#define FMT_ZERO   0x02     // '0': pad numbers with zeros
+#define FMT_PLUS   0x04     // '+': always show a sign
+#define FMT_SPACE  0x08     // ' ': space where a '+' would go
+#define FMT_ALT    0x10     // '#': 0x / leading 0 prefix
+#define FMT_UPPER  0x20     // Upper-case hex digits
+
+// Output for vsnprintf; writes stop at the end of buf but len keeps
+// counting, so the caller learns how much space was needed
+typedef struct {
+    char* buf;
+    size_t size;
+    size_t len;
+} fmt_out_t;
+
+static inline void fmt_putc(fmt_out_t* out, char c) {
+    if (out->len + 1 < out->size) {
+        out->buf[out->len] = c;
+    }
+    out->len++;
+}
+
+static void fmt_pad(fmt_out_t* out, char c, int count) {
+    while (count-- > 0) {
+        fmt_putc(out, c);
+    }
+}
+
+static void fmt_string(fmt_out_t* out, const char* str, int flags, int width, int precision) {
+    if (str == NULL) str = "(null)";
+    
+    // With a precision the string needn't be terminated
+    size_t len;
+    if (precision >= 0) {
+        const char* end = memchr(str, '\0', (size_t)precision);
+        len = end ? (size_t)(end - str) : (size_t)precision;
+    } else {
+        len = strlen(str);
+    }
+    
+    int pad = width > (int)len ? width - (int)len : 0;
+    if (!(flags & FMT_LEFT)) fmt_pad(out, ' ', pad);
+    for (size_t i = 0; i < len; i++) {
+        fmt_putc(out, str[i]);
+    }
+    if (flags & FMT_LEFT) fmt_pad(out, ' ', pad);
+}
+
+static void fmt_number(fmt_out_t* out, uint64_t value, bool negative, unsigned base,
+                       int flags, int width, int precision) {
+    const char* digits = (flags & FMT_UPPER) ? "0123456789ABCDEF" : "0123456789abcdef";
+    char tmp[24];
+    int count = 0;
+    
+    // Digits, least significant first; precision 0 prints nothing for 0
+    if (value != 0 || precision != 0) {
+        do {
+            uint32_t digit;
+            if (base == 10) {
+                value = div_u64_rem(value, 10, &digit);
+            } else {
+                digit = (uint32_t)value & (base - 1);
+                value >>= (base == 16) ? 4 : 3;
+            }
+            tmp[count++] = digits[digit];
+        } while (value);
+    }
+    
+    char sign = negative ? '-' : (flags & FMT_PLUS) ? '+' : (flags & FMT_SPACE) ? ' ' : 0;
+    const char* prefix = "";
+    if ((flags & FMT_ALT) && base == 16 && count > 0 && tmp[count - 1] != '0') {
+        prefix = (flags & FMT_UPPER) ? "0X" : "0x";
+    } else if ((flags & FMT_ALT) && base == 8 && precision <= count &&
+               (count == 0 || tmp[count - 1] != '0')) {
+        precision = count + 1;
+    }
+    
+    int zeros = precision > count ? precision - count : 0;
+    int body = (sign ? 1 : 0) + (int)strlen(prefix) + zeros + count;
+    int pad = width > body ? width - body : 0;
+    
+    // Zero padding goes between the sign/prefix and the digits
+    if ((flags & FMT_ZERO) && !(flags & FMT_LEFT) && precision < 0) {
+        zeros += pad;
+        pad = 0;
+    }
+    
+    if (!(flags & FMT_LEFT)) fmt_pad(out, ' ', pad);
+    if (sign) fmt_putc(out, sign);
+    while (*prefix) {
+        fmt_putc(out, *prefix++);
+    }
+    fmt_pad(out, '0', zeros);
+    while (count > 0) {
+        fmt_putc(out, tmp[--count]);
+    }
+    if (flags & FMT_LEFT) fmt_pad(out, ' ', pad);
+}
+
+int vsnprintf(char* buf, size_t size, const char* format, va_list args) {
+    fmt_out_t out = { buf, size, 0 };
+    
+    while (*format) {
+        if (*format != '%') {
+            fmt_putc(&out, *format++);
+            continue;
+        }
+        const char* spec = format++;
+        
+        // Flags
+        int flags = 0;
+        for (;; format++) {
+            if (*format == '-') flags |= FMT_LEFT;
+            else if (*format == '0') flags |= FMT_ZERO;
+            else if (*format == '+') flags |= FMT_PLUS;
+            else if (*format == ' ') flags |= FMT_SPACE;
+            else if (*format == '#') flags |= FMT_ALT;
+            else break;
+        }
+        
+        // Width and precision, either inline or taken from the arguments
+        int width = 0;
+        if (*format == '*') {
+            width = va_arg(args, int);
+            if (width < 0) {
+                flags |= FMT_LEFT;
+                width = -width;
+            }
+            format++;
+        } else {
+            while (isdigit(*format)) {
+                width = width * 10 + (*format++ - '0');
+            }
+        }
+        
+        int precision = -1;
+        if (*format == '.') {
+            format++;
+            precision = 0;
+            if (*format == '*') {
+                precision = va_arg(args, int);
+                format++;
+            } else {
+                while (isdigit(*format)) {
+                    precision = precision * 10 + (*format++ - '0');
+                }
+            }
+        }
+        
+        // Length: 2 for ll, 1 for l/z, 0 for int, -1 for h, -2 for hh
+        int length = 0;
+        if (*format == 'l') {
+            length = 1;
+            if (*++format == 'l') {
+                length = 2;
+                format++;
+            }
+        } else if (*format == 'z') {
+            length = 1;
+            format++;
+        } else if (*format == 'h') {
+            length = -1;
+            if (*++format == 'h') {
+                length = -2;
+                format++;
+            }
+        }
+        
+        char conv = *format;
+        if (conv == '\0') break;
+        format++;
+        
+        switch (conv) {
+            case 'd':
+            case 'i': {
+                int64_t v = (length == 2) ? va_arg(args, long long) :
+                            (length == 1) ? va_arg(args, long) : va_arg(args, int);
+                if (length == -1) v = (short)v;
+                if (length == -2) v = (signed char)v;
+                uint64_t mag = v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+                fmt_number(&out, mag, v < 0, 10, flags, width, precision);
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o': {
+                uint64_t v = (length == 2) ? va_arg(args, unsigned long long) :
+                             (length == 1) ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+                if (length == -1) v = (unsigned short)v;
+                if (length == -2) v = (unsigned char)v;
+                if (conv == 'X') flags |= FMT_UPPER;
+                flags &= ~(FMT_PLUS | FMT_SPACE);
+                fmt_number(&out, v, false, conv == 'u' ? 10 : conv == 'o' ? 8 : 16,
+                           flags, width, precision);
+                break;
+            }
+            case 'p': {
+                // Always 0x and every digit, so addresses line up
+                uintptr_t v = (uintptr_t)va_arg(args, void*);
+                fmt_number(&out, v, false, 16, (flags & FMT_LEFT) | FMT_ALT, width,
+                           (int)sizeof(void*) * 2);
+                break;
+            }
+            case 's':
+                fmt_string(&out, va_arg(args, const char*), flags, width, precision);
+                break;
+            case 'c': {
+                char c = (char)va_arg(args, int);
+                if (!(flags & FMT_LEFT)) fmt_pad(&out, ' ', width - 1);
+                fmt_putc(&out, c);
+                if (flags & FMT_LEFT) fmt_pad(&out, ' ', width - 1);
+                break;
+            }
+            case '%':
+                fmt_putc(&out, '%');
+                break;
+            default:
+                // Unknown conversion: print it as written
+                while (spec < format) {
+                    fmt_putc(&out, *spec++);
+                }
+                break;
+        }
+    }
+    
+    if (size > 0) {
+        buf[out.len < size ? out.len : size - 1] = '\0';
+    }
+    return (int)out.len;
+}
+
+int ksnprintf(char* buf, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, size, format, args);
+    va_end(args);
+    return len;
+}
+
 int isdigit(int c) {
     return c >= '0' && c <= '9';
 }
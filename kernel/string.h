@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdarg.h>
 
 // String length
 size_t strlen(const char* str);
@@ -25,9 +26,24 @@ char* strcat(char* dest, const char* src);
 // Find character in string
 char* strchr(const char* str, int c);
 
+// Find byte in memory
+void* memchr(const void* ptr, int c, size_t num);
+
+// Find last occurrence of byte in memory
+void* memrchr(const void* ptr, int c, size_t num);
+
 // Find substring in string
 char* strstr(const char* haystack, const char* needle);
 
+// Find a byte string in memory
+void* memmem(const void* haystack, size_t hlen, const void* needle, size_t nlen);
+
+// Pick memcpy/memset strategies for this CPU; enables SSE if present
+void string_init(void);
+
+// Name of the strategy string_init picked
+const char* string_variant(void);
+
 // Memory set
 void* memset(void* ptr, int value, size_t num);
 
@@ -46,6 +62,15 @@ void itoa(int value, char* str, int base);
 // Unsigned integer to string
 void utoa(unsigned int value, char* str, int base);
 
+// Format into buf, writing at most size bytes including the NUL. Supports
+// %d %i %u %x %X %o %p %s %c %% with flags -0+ #, width and precision
+// (or *), and the hh h l ll z lengths. Returns the length the whole
+// output needed, which may exceed size.
+int vsnprintf(char* buf, size_t size, const char* format, va_list args);
+
+// vsnprintf with variable arguments
+int ksnprintf(char* buf, size_t size, const char* format, ...);
+
 // String to integer
 int atoi(const char* str);
 
@@ -0,0 +1,72 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <stdint.h>
+
+// Interrupt masking and spinlocks. MiniOS runs on one CPU, so a lock is
+// never contended yet; it is taken with interrupts off so that data shared
+// with IRQ handlers (and later with other CPUs) stays consistent. Hosted
+// builds (the bench/ tools) run in user mode with no interrupts to mask.
+
+#define MAX_CPUS 1
+
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+#define EFLAGS_IF 0x200
+
+// Disable interrupts; returns the previous EFLAGS for irq_restore
+static inline uint32_t irq_save(void) {
+#if __STDC_HOSTED__
+    return 0;
+#else
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+#endif
+}
+
+// Re-enable interrupts if they were on when irq_save was called
+static inline void irq_restore(uint32_t flags) {
+#if __STDC_HOSTED__
+    (void)flags;
+#else
+    if (flags & EFLAGS_IF) {
+        __asm__ volatile ("sti" : : : "memory");
+    }
+#endif
+}
+
+static inline void spin_lock(spinlock_t* lock) {
+    while (__sync_lock_test_and_set(&lock->locked, 1)) {
+        while (lock->locked) {
+            __asm__ volatile ("pause");
+        }
+    }
+}
+
+static inline void spin_unlock(spinlock_t* lock) {
+    __sync_lock_release(&lock->locked);
+}
+
+// Take a lock with interrupts off; returns the flags to restore
+static inline uint32_t spin_lock_irqsave(spinlock_t* lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+// Index of the CPU we are running on
+static inline int cpu_id(void) {
+    return 0;
+}
+
+#endif // SYNC_H
@@ -0,0 +1,209 @@
+#include "timer.h"
+#include "apic.h"
+#include "cpu.h"
+#include "idt.h"
+#include "io.h"
+#include "ktimer.h"
+#include "math64.h"
+#include "sync.h"
+
+// Channel 0, lobyte/hibyte, mode 2 (rate generator)
+#define PIT_MODE_RATE   0x34
+// Channel 0 counter latch
+#define PIT_LATCH       0x00
+
+static volatile uint64_t ticks = 0;
+static uint32_t tick_hz = 0;
+static uint32_t period = 0;     // PIT input clocks per tick
+
+// TSC clocksource: rate and the count at timer_init
+static uint32_t tsc_khz = 0;
+static uint64_t tsc_base = 0;
+
+// Local APIC timer counts per tick, when it drives the tick
+static uint32_t apic_per_tick = 0;
+
+// Last time the PIT clocksource gave out, to keep it from going back
+static uint64_t last_pit_ns = 0;
+
+static void pit_tick(registers_t* regs) {
+    (void)regs;
+    ticks++;
+    ktimer_tick();
+}
+
+// One-shot, so it is armed again for the next tick
+static void apic_tick(registers_t* regs) {
+    (void)regs;
+    ticks++;
+    apic_timer_start(apic_per_tick, false);
+    ktimer_tick();
+}
+
+// Current channel 0 count; it runs down from divisor and reloads
+static uint16_t pit_read_count(void) {
+    uint32_t flags = irq_save();
+    outb(PIT_COMMAND, PIT_LATCH);
+    uint8_t lo = inb(PIT_CHANNEL0);
+    uint8_t hi = inb(PIT_CHANNEL0);
+    irq_restore(flags);
+    return (uint16_t)(lo | (hi << 8));
+}
+
+// Count reloads of channel 0, one per tick period; for callers running
+// with interrupts off, where ticks doesn't advance
+static void poll_ticks(uint64_t count) {
+    uint16_t last = pit_read_count();
+
+    while (count) {
+        uint16_t now = pit_read_count();
+        if (now > last) count--;
+        last = now;
+    }
+}
+
+// Whether the TSC runs at a fixed rate: either the CPU says it is
+// invariant, or we are under a hypervisor, which gives guests a constant
+// rate TSC whatever the host's power states do
+static bool tsc_usable(void) {
+    uint32_t a, b, c, d;
+
+    if (!(cpu_features_edx() & CPUID_EDX_TSC)) return false;
+    if (cpu_features_ecx() & CPUID_ECX_HYPERVISOR) return true;
+    if (cpu_max_ext_leaf() < 0x80000007) return false;
+    cpuid(0x80000007, &a, &b, &c, &d);
+    return (d & CPUID_EXT7_EDX_INVTSC) != 0;
+}
+
+// Count TSC cycles, and local APIC timer counts if it is in use, over
+// TSC_CALIBRATE_MS of channel 0 periods. The PIT is polled with
+// interrupts off, so a late IRQ can't skew the result.
+static void calibrate(bool tsc, bool apic) {
+    uint32_t periods = tick_hz * TSC_CALIBRATE_MS / 1000;
+    if (periods == 0) periods = 1;
+
+    uint32_t flags = irq_save();
+    poll_ticks(1);              // Start on a reload
+    if (apic) apic_timer_start(0xFFFFFFFFu, true);
+    uint64_t start = tsc ? rdtsc() : 0;
+    poll_ticks(periods);
+    uint64_t cycles = tsc ? rdtsc() - start : 0;
+    uint32_t counted = apic ? 0xFFFFFFFFu - apic_timer_remaining() : 0;
+    irq_restore(flags);
+
+    // cycles / (periods * period / PIT_FREQUENCY seconds) / 1000
+    if (tsc) {
+        tsc_khz = (uint32_t)div_u64(cycles * PIT_FREQUENCY, periods * period * 1000);
+        tsc_base = rdtsc();
+    }
+    if (apic) {
+        apic_per_tick = counted / periods;
+        if (apic_per_tick == 0) apic_per_tick = 1;
+    }
+}
+
+void timer_init(uint32_t hz) {
+    // The divisor is 16 bits, with 0 meaning 65536
+    if (hz < PIT_FREQUENCY / 65536 + 1) hz = PIT_FREQUENCY / 65536 + 1;
+    if (hz > PIT_FREQUENCY / 2) hz = PIT_FREQUENCY / 2;
+
+    uint32_t div = (PIT_FREQUENCY + hz / 2) / hz;
+    tick_hz = hz;
+    period = div;
+
+    // Channel 0 runs even when the local APIC timer drives the tick: it
+    // is the reference for calibration and for ksleep_ms with interrupts
+    // off
+    outb(PIT_COMMAND, PIT_MODE_RATE);
+    outb(PIT_CHANNEL0, (uint8_t)(div & 0xFF));
+    outb(PIT_CHANNEL0, (uint8_t)((div >> 8) & 0xFF));
+
+    // The one-shot local APIC timer drifts by the interrupt latency each
+    // tick, so it only takes over when the TSC keeps time instead
+    bool tsc = tsc_usable();
+    bool apic = tsc && apic_enabled();
+    calibrate(tsc, apic);
+
+    if (apic) {
+        irq_register_handler(IRQ_APIC_TIMER, apic_tick);
+        apic_timer_start(apic_per_tick, false);
+    } else {
+        irq_register_handler(0, pit_tick);
+        irq_unmask(0);
+    }
+}
+
+uint32_t timer_get_hz(void) {
+    return tick_hz;
+}
+
+uint64_t timer_ticks(void) {
+    // Two 32-bit loads; keep the handler from landing between them
+    uint32_t flags = irq_save();
+    uint64_t now = ticks;
+    irq_restore(flags);
+    return now;
+}
+
+uint64_t ktime_ms(void) {
+    if (tsc_khz) return div_u64(ktime_ns(), 1000000);
+    if (tick_hz == 0) return 0;
+    return div_u64(timer_ticks() * 1000, tick_hz);
+}
+
+// Ticks plus the part of the current period the PIT count has run down
+static uint64_t pit_ns(void) {
+    uint32_t flags = irq_save();
+    uint16_t count = pit_read_count();
+    uint64_t clocks = ticks * period + (period - count);
+
+    uint32_t rem;
+    uint64_t seconds = div_u64_rem(clocks, PIT_FREQUENCY, &rem);
+    uint64_t ns = seconds * 1000000000u + div_u64((uint64_t)rem * 1000000000u, PIT_FREQUENCY);
+
+    // A reload whose IRQ is still pending reads as time going back
+    if (ns < last_pit_ns) ns = last_pit_ns;
+    last_pit_ns = ns;
+    irq_restore(flags);
+    return ns;
+}
+
+uint64_t ktime_ns(void) {
+    if (tsc_khz) {
+        uint32_t rem;
+        uint64_t ms = div_u64_rem(rdtsc() - tsc_base, tsc_khz, &rem);
+        return ms * 1000000u + div_u64((uint64_t)rem * 1000000u, tsc_khz);
+    }
+    if (tick_hz == 0) return 0;
+    return pit_ns();
+}
+
+uint32_t timer_tsc_khz(void) {
+    return tsc_khz;
+}
+
+const char* timer_clocksource(void) {
+    return tsc_khz ? "tsc" : "pit";
+}
+
+const char* timer_tick_source(void) {
+    return apic_per_tick ? "local APIC" : "PIT";
+}
+
+void ksleep_ms(uint32_t ms) {
+    if (tick_hz == 0 || ms == 0) return;
+
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0" : "=r"(flags));
+    if (!(flags & EFLAGS_IF)) {
+        // Round up, plus one because the current period is under way
+        poll_ticks(div_u64((uint64_t)ms * tick_hz + 999, 1000) + 1);
+        return;
+    }
+
+    // Every tick wakes the halt to look at the clock again
+    uint64_t deadline = ktime_ns() + (uint64_t)ms * 1000000u;
+    while (ktime_ns() < deadline) {
+        hlt();
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// System tick and the monotonic clocks built on it. Both clocks start at
+// timer_init and never go backwards. ktime_ns reads the TSC, calibrated
+// against the PIT at boot, when its rate is known to be constant, and the
+// tick then comes from the one-shot local APIC timer if the APICs are in
+// use. Otherwise PIT channel 0 ticks on IRQ0 and ktime_ns interpolates
+// between ticks with the PIT count.
+
+// 8253/8254 PIT ports and input clock
+#define PIT_CHANNEL0    0x40
+#define PIT_CHANNEL2    0x42
+#define PIT_COMMAND     0x43
+#define PIT_FREQUENCY   1193182
+
+// Default tick rate
+#define TIMER_HZ        1000
+
+// How long timer_init measures the TSC for
+#define TSC_CALIBRATE_MS 50
+
+// Start hz ticks a second, calibrating the TSC and local APIC timer
+// against the PIT; call after idt_init and apic_init
+void timer_init(uint32_t hz);
+
+// Tick rate timer_init set up (0 before it runs)
+uint32_t timer_get_hz(void);
+
+// Ticks since timer_init
+uint64_t timer_ticks(void);
+
+// Milliseconds since timer_init
+uint64_t ktime_ms(void);
+
+// Nanoseconds since timer_init
+uint64_t ktime_ns(void);
+
+// Calibrated TSC rate in kHz, or 0 if ktime_ns isn't using the TSC
+uint32_t timer_tsc_khz(void);
+
+// Name of the source ktime_ns reads ("tsc" or "pit")
+const char* timer_clocksource(void);
+
+// Name of what raises the tick ("local APIC" or "PIT")
+const char* timer_tick_source(void);
+
+// Wait at least ms milliseconds. Halts between ticks when interrupts are
+// on; with them off it watches the PIT count instead.
+void ksleep_ms(uint32_t ms);
+
+#endif // TIMER_H
@@ -6,6 +6,9 @@
 // VGA buffer address
 static uint16_t* const VGA_BUFFER = (uint16_t*)0xB8000;
 
+// Longest vga_printf output; anything past it is cut off
+#define VGA_PRINTF_MAX 512
+
 // VGA state
 static int cursor_x = 0;
 static int cursor_y = 0;
@@ -53,18 +56,15 @@ uint8_t vga_get_color(void) {
 
 void vga_scroll(void) {
     // Move all lines up by one
-    for (int y = 0; y < VGA_HEIGHT - 1; y++) {
-        for (int x = 0; x < VGA_WIDTH; x++) {
-            VGA_BUFFER[y * VGA_WIDTH + x] = VGA_BUFFER[(y + 1) * VGA_WIDTH + x];
-        }
-    }
+    memmove(VGA_BUFFER, VGA_BUFFER + VGA_WIDTH, (VGA_HEIGHT - 1) * VGA_WIDTH * sizeof(uint16_t));
     // Clear the last line
     for (int x = 0; x < VGA_WIDTH; x++) {
         VGA_BUFFER[(VGA_HEIGHT - 1) * VGA_WIDTH + x] = vga_entry(' ', current_color);
     }
 }
 
-void vga_putchar(char c) {
+// Put a character and advance, leaving the hardware cursor alone
+static void put_raw(char c) {
     if (c == '\n') {
         cursor_x = 0;
         cursor_y++;
@@ -91,7 +91,10 @@ void vga_putchar(char c) {
         vga_scroll();
         cursor_y = VGA_HEIGHT - 1;
     }
-    
+}
+
+void vga_putchar(char c) {
+    put_raw(c);
     vga_update_cursor(cursor_x, cursor_y);
 }
 
@@ -103,8 +106,16 @@ void vga_putchar_at(char c, int x, int y) {
 
 void vga_puts(const char* str) {
     while (*str) {
-        vga_putchar(*str++);
+        put_raw(*str++);
+    }
+    vga_update_cursor(cursor_x, cursor_y);
+}
+
+void vga_write(const char* str, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        put_raw(str[i]);
     }
+    vga_update_cursor(cursor_x, cursor_y);
 }
 
 void vga_puts_at(const char* str, int x, int y) {
@@ -118,75 +129,15 @@ void vga_puts_at(const char* str, int x, int y) {
 }
 
 void vga_printf(const char* format, ...) {
+    char buffer[VGA_PRINTF_MAX];
     va_list args;
-    va_start(args, format);
-    
-    char buffer[256];
-    int i = 0;
-    
-    while (*format && i < 255) {
-        if (*format == '%') {
-            format++;
-            switch (*format) {
-                case 'd':
-                case 'i': {
-                    int val = va_arg(args, int);
-                    char num_buf[32];
-                    itoa(val, num_buf, 10);
-                    for (char* p = num_buf; *p; p++) {
-                        vga_putchar(*p);
-                    }
-                    break;
-                }
-                case 'u': {
-                    unsigned int val = va_arg(args, unsigned int);
-                    char num_buf[32];
-                    utoa(val, num_buf, 10);
-                    for (char* p = num_buf; *p; p++) {
-                        vga_putchar(*p);
-                    }
-                    break;
-                }
-                case 'x':
-                case 'X': {
-                    unsigned int val = va_arg(args, unsigned int);
-                    char num_buf[32];
-                    utoa(val, num_buf, 16);
-                    for (char* p = num_buf; *p; p++) {
-                        vga_putchar(*format == 'X' ? toupper(*p) : *p);
-                    }
-                    break;
-                }
-                case 's': {
-                    char* str = va_arg(args, char*);
-                    if (str) {
-                        vga_puts(str);
-                    } else {
-                        vga_puts("(null)");
-                    }
-                    break;
-                }
-                case 'c': {
-                    char c = (char)va_arg(args, int);
-                    vga_putchar(c);
-                    break;
-                }
-                case '%': {
-                    vga_putchar('%');
-                    break;
-                }
-                default:
-                    vga_putchar('%');
-                    vga_putchar(*format);
-                    break;
-            }
-        } else {
-            vga_putchar(*format);
-        }
-        format++;
-    }
     
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
+    
+    if (len > (int)sizeof(buffer) - 1) len = sizeof(buffer) - 1;
+    vga_write(buffer, len);
 }
 
 void vga_enable_cursor(uint8_t cursor_start, uint8_t cursor_end) {
@@ -71,7 +71,10 @@ void vga_puts(const char* str);
 // Put string at specific position
 void vga_puts_at(const char* str, int x, int y);
 
-// Print formatted string (basic printf)
+// Put len characters at the current position, updating the cursor once
+void vga_write(const char* str, size_t len);
+
+// Print formatted string; see vsnprintf for the supported conversions
 void vga_printf(const char* format, ...);
 
 // Scroll screen up by one line
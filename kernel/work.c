@@ -0,0 +1,121 @@
+#include "work.h"
+#include "cpu.h"
+#include "sync.h"
+#include "timer.h"
+
+// Each CPU's queue is a stack that top halves push onto with a
+// compare-and-swap; work_run takes the whole stack at once and reverses
+// it, so nothing else needs a lock.
+typedef struct {
+    work_t* volatile head;    // Newest first
+    bool running;
+} cpu_queue_t;
+
+static cpu_queue_t queues[MAX_CPUS];
+static work_stats_t stats[WORK_TYPE_COUNT];
+
+static const char* const type_names[WORK_TYPE_COUNT] = {
+    [WORK_TIMER] = "timer",
+    [WORK_KEYBOARD] = "keyboard",
+};
+
+void work_init(work_t* work, work_type_t type, work_fn_t fn, void* data) {
+    work->next = NULL;
+    work->fn = fn;
+    work->data = data;
+    work->type = type;
+    work->queued = 0;
+}
+
+bool work_queue(work_t* work) {
+    work_stats_t* s = &stats[work->type];
+
+    if (__sync_lock_test_and_set(&work->queued, 1)) {
+        __sync_fetch_and_add(&s->merged, 1);
+        return false;
+    }
+
+    cpu_queue_t* q = &queues[cpu_id()];
+    work_t* head;
+    do {
+        head = q->head;
+        work->next = head;
+    } while (!__sync_bool_compare_and_swap(&q->head, head, work));
+
+    __sync_fetch_and_add(&s->queued, 1);
+    uint32_t depth = __sync_add_and_fetch(&s->depth, 1);
+    if (depth > s->max_depth) s->max_depth = depth;
+    return true;
+}
+
+// Run one batch taken off the queue, oldest first
+static void run_list(work_t* list) {
+    work_t* ordered = NULL;
+    while (list) {
+        work_t* next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    // Cycle counts only where the TSC is known to run at a fixed rate
+    bool timed = timer_tsc_khz() != 0;
+
+    while (ordered) {
+        work_t* work = ordered;
+        ordered = work->next;
+
+        work_stats_t* s = &stats[work->type];
+        __sync_fetch_and_sub(&s->depth, 1);
+
+        // From here the item can be queued again, even by itself
+        __sync_lock_release(&work->queued);
+
+        uint64_t start = timed ? rdtsc() : 0;
+        work->fn(work->data);
+        s->run++;
+        if (timed) {
+            uint64_t cycles = rdtsc() - start;
+            s->cycles += cycles;
+            if (cycles > s->max_cycles) {
+                s->max_cycles = cycles > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)cycles;
+            }
+        }
+    }
+}
+
+void work_run(void) {
+    cpu_queue_t* q = &queues[cpu_id()];
+    if (q->head == NULL) return;
+
+    // An IRQ taken while work runs comes back here; the outer run takes
+    // whatever that IRQ queued
+    uint32_t flags = irq_save();
+    if (q->running) {
+        irq_restore(flags);
+        return;
+    }
+    q->running = true;
+
+    // Only stop once the queue is seen empty with interrupts off, so
+    // nothing queued on the way out is left behind
+    while (q->head) {
+        irq_restore(EFLAGS_IF);
+        work_t* list;
+        while ((list = __sync_lock_test_and_set(&q->head, NULL)) != NULL) {
+            run_list(list);
+        }
+        irq_save();
+    }
+
+    q->running = false;
+    irq_restore(flags);
+}
+
+void work_get_stats(work_type_t type, work_stats_t* out) {
+    if (out == NULL || (unsigned)type >= WORK_TYPE_COUNT) return;
+    uint32_t flags = irq_save();
+    *out = stats[type];
+    irq_restore(flags);
+    out->name = type_names[type];
+}
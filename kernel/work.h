@@ -0,0 +1,60 @@
+#ifndef WORK_H
+#define WORK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Deferred work for IRQ handlers. A handler (the top half) does only what
+// can't wait, such as reading the device, and queues a work item for the
+// rest. Queued items run on the way out of the IRQ, after the EOI and
+// with interrupts enabled, in the order they were queued. Queueing is
+// lock-free, onto a queue per CPU, so it is safe from any context.
+
+// What a work item is for; statistics are kept per type
+typedef enum {
+    WORK_TIMER,
+    WORK_KEYBOARD,
+    WORK_TYPE_COUNT
+} work_type_t;
+
+typedef void (*work_fn_t)(void* data);
+
+typedef struct work {
+    struct work* next;
+    work_fn_t fn;
+    void* data;
+    work_type_t type;
+    volatile uint32_t queued;   // Set while waiting to run
+} work_t;
+
+#define WORK_INIT(type, fn, data) { NULL, (fn), (data), (type), 0 }
+
+// Per type statistics
+typedef struct {
+    const char* name;
+    uint32_t queued;          // Times queued
+    uint32_t merged;          // Queue calls on an item already waiting
+    uint32_t run;             // Times run
+    uint32_t depth;           // Items of this type waiting now
+    uint32_t max_depth;
+    uint64_t cycles;          // TSC cycles spent running, 0 without a TSC
+    uint32_t max_cycles;      // Longest single run
+} work_stats_t;
+
+// Set up a work item to call fn(data)
+void work_init(work_t* work, work_type_t type, work_fn_t fn, void* data);
+
+// Queue a work item to run; false if it was already waiting, in which
+// case the one run covers both
+bool work_queue(work_t* work);
+
+// Run this CPU's queued work with interrupts enabled. Called on the way
+// out of every IRQ; code that queues work outside an IRQ calls it too,
+// rather than wait for the next interrupt.
+void work_run(void);
+
+// Get statistics for one type
+void work_get_stats(work_type_t type, work_stats_t* stats);
+
+#endif // WORK_H